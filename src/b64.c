@@ -0,0 +1,94 @@
+/* b64.c -- Base64 number encoding used by dictd .index files
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* Stand-in for libmaa's base64.c, which is not linked into the Win32
+   build.  Only the functions declared in maa.h are provided. */
+
+#ifdef DICTZIP_WIN32
+
+#include "maa.h"
+
+#include <string.h>
+
+static const char b64_list[] =
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define XX 100
+
+static const int b64_index[256] = {
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,62, XX,XX,XX,63,
+   52,53,54,55, 56,57,58,59, 60,61,XX,XX, XX,XX,XX,XX,
+   XX, 0, 1, 2,  3, 4, 5, 6,  7, 8, 9,10, 11,12,13,14,
+   15,16,17,18, 19,20,21,22, 23,24,25,XX, XX,XX,XX,XX,
+   XX,26,27,28, 29,30,31,32, 33,34,35,36, 37,38,39,40,
+   41,42,43,44, 45,46,47,48, 49,50,51,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+   XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX, XX,XX,XX,XX,
+};
+
+/* |b64_encode| encodes |val| in a printable base 64 format.  The result is
+   in a static buffer and has no leading zero digits ('A'). */
+
+const char *b64_encode( unsigned long val )
+{
+   static char   result[7];
+   int           i;
+
+   result[0] = b64_list[ (val & 0xc0000000) >> 30 ];
+   result[1] = b64_list[ (val & 0x3f000000) >> 24 ];
+   result[2] = b64_list[ (val & 0x00fc0000) >> 18 ];
+   result[3] = b64_list[ (val & 0x0003f000) >> 12 ];
+   result[4] = b64_list[ (val & 0x00000fc0) >>  6 ];
+   result[5] = b64_list[ (val & 0x0000003f)       ];
+   result[6] = 0;
+
+   for (i = 0; i < 5; i++) if (result[i] != b64_list[0]) return result + i;
+   return result + 5;
+}
+
+/* |b64_decode_buf| decodes the first |len| characters of |val|.  Decoding
+   stops early at the first character outside the base 64 alphabet. */
+
+unsigned long b64_decode_buf( const char *val, size_t len )
+{
+   unsigned long v = 0;
+   size_t        i;
+   int           d;
+
+   for (i = 0; i < len; i++) {
+      if ((d = b64_index[ (unsigned char) val[i] ]) == XX)
+	 break;
+      v = (v << 6) + d;
+   }
+
+   return v;
+}
+
+unsigned long b64_decode( const char *val )
+{
+   return b64_decode_buf( val, strlen( val ) );
+}
+
+#endif /* DICTZIP_WIN32 */
@@ -0,0 +1,257 @@
+/* batch.c -- Extract many ranges in one run
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "data.h"
+#include "batch.h"
+
+#include <ctype.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+typedef struct dictBatchFile {
+   char     *name;
+   dictData *data;
+} dictBatchFile;
+
+typedef struct dictBatchRequest {
+   int           file;
+   unsigned long start;
+   unsigned long size;
+   const char    *text;		/* inside one of the batch's reads */
+} dictBatchRequest;
+
+typedef struct dictBatch {
+   dictBatchFile    *files;
+   int              fileCount;
+   int              fileMax;
+   dictBatchRequest *requests;
+   dictBatchRequest **sorted;
+   char             **reads;
+   int              count;
+   unsigned long    bytes;
+} dictBatch;
+
+static const char dictBatchDigits[] =
+   "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int dict_batch_number( const char *text, int base64,
+			      unsigned long *val )
+{
+   char *end;
+
+   if (!*text)
+      return 0;
+   if (base64) {
+      if (text[strspn( text, dictBatchDigits )])
+	 return 0;
+      *val = b64_decode( text );
+   } else {
+      if (!isdigit( (unsigned char) *text ))
+	 return 0;
+      *val = strtoul( text, &end, 10 );
+      if (*end)
+	 return 0;
+   }
+   return 1;
+}
+
+/* The last word of |line|, which ends at |*end|; cut it off. */
+static char *dict_batch_word( char *line, char **end )
+{
+   char *pt = *end;
+
+   while (pt > line && isspace( (unsigned char) pt[-1] ))
+      --pt;
+   *pt = '\0';
+   while (pt > line && !isspace( (unsigned char) pt[-1] ))
+      --pt;
+   *end = pt;
+   return pt;
+}
+
+static int dict_batch_file( dictBatch *b, const char *name )
+{
+   dictBatchFile *files;
+   dictData      *h;
+   int           i;
+
+   for (i = b->fileCount - 1; i >= 0; i--)
+      if (!strcmp( b->files[i].name, name ))
+	 return i;
+
+   h = dict_data_open( name, 0 );
+   if (h->type != DICT_TEXT && h->type != DICT_DZIP)
+      err_fatal( __func__, "Cannot read ranges of %s\n", name );
+
+   if (b->fileCount == b->fileMax) {
+      b->fileMax = b->fileMax ? 2 * b->fileMax : 16;
+      files      = xmalloc( b->fileMax * sizeof( dictBatchFile ) );
+      if (b->files) {
+	 memcpy( files, b->files, b->fileCount * sizeof( dictBatchFile ) );
+	 xfree( b->files );
+      }
+      b->files = files;
+   }
+   b->files[b->fileCount].name = xmalloc( strlen( name ) + 1 );
+   strcpy( b->files[b->fileCount].name, name );
+   b->files[b->fileCount].data = h;
+   return b->fileCount++;
+}
+
+static int dict_batch_compare( const void *a, const void *b )
+{
+   const dictBatchRequest *x = *(const dictBatchRequest * const *) a;
+   const dictBatchRequest *y = *(const dictBatchRequest * const *) b;
+
+   if (x->file != y->file)
+      return x->file < y->file ? -1 : 1;
+   if (x->start != y->start)
+      return x->start < y->start ? -1 : 1;
+   return 0;
+}
+
+/* Read the ranges of the batch and write them in request order. */
+static void dict_batch_flush(
+   dictBatch *b, FILE *out, const char *delimiter, int delimiterLength )
+{
+   dictBatchRequest *r;
+   dictData         *h;
+   unsigned long    start, end, gap;
+   char             *text;
+   int              reads = 0;
+   int              i, j, k;
+
+   for (i = 0; i < b->count; i++)
+      b->sorted[i] = &b->requests[i];
+   qsort( b->sorted, b->count, sizeof( b->sorted[0] ), dict_batch_compare );
+
+				/* join ranges less than a chunk apart */
+   for (i = 0; i < b->count; i = j) {
+      r     = b->sorted[i];
+      h     = b->files[r->file].data;
+      gap   = h->type == DICT_DZIP ? h->chunkLength : DICT_STREAM_SLICE;
+      start = r->start;
+      end   = r->start + r->size;
+      for (j = i + 1;
+	   j < b->count
+	      && b->sorted[j]->file == r->file
+	      && b->sorted[j]->start <= end + gap
+	      && b->sorted[j]->start + b->sorted[j]->size
+		 <= start + DICT_BATCH_SPAN;
+	   j++)
+	 if (b->sorted[j]->start + b->sorted[j]->size > end)
+	    end = b->sorted[j]->start + b->sorted[j]->size;
+
+      text = b->reads[reads++] = dict_data_read_( h, start, end - start,
+						  NULL, NULL );
+      for (k = i; k < j; k++)
+	 b->sorted[k]->text = text + (b->sorted[k]->start - start);
+   }
+
+   for (i = 0; i < b->count; i++) {
+      r = &b->requests[i];
+      if (!delimiter)
+	 fprintf( out, "%lu\n", r->size );
+      fwrite( r->text, 1, r->size, out );
+      if (delimiter)
+	 fwrite( delimiter, 1, delimiterLength, out );
+   }
+   if (fflush( out ) || ferror( out ))
+      err_fatal_errno( __func__, "Cannot write ranges\n" );
+
+   for (i = 0; i < reads; i++)
+      xfree( b->reads[i] );
+   b->count = 0;
+   b->bytes = 0;
+}
+
+int dict_batch(
+   FILE *in, FILE *out, int base64,
+   const char *delimiter, int delimiterLength )
+{
+   dictBatch        b;
+   dictBatchRequest *r;
+   dictData         *h;
+   char             line[BUFFERSIZE];
+   char             *end, *sizeText, *startText;
+   unsigned long    lineNumber = 0;
+   int              eof, i;
+
+#ifdef _WIN32
+   _setmode( _fileno( out ), _O_BINARY );
+#endif
+
+   memset( &b, 0, sizeof( b ) );
+   b.requests = xmalloc( DICT_BATCH_REQUESTS * sizeof( dictBatchRequest ) );
+   b.sorted   = xmalloc( DICT_BATCH_REQUESTS * sizeof( dictBatchRequest * ) );
+   b.reads    = xmalloc( DICT_BATCH_REQUESTS * sizeof( char * ) );
+
+   for (;;) {
+      if (!(eof = !fgets( line, sizeof( line ), in ))) {
+	 ++lineNumber;
+	 end = line + strlen( line );
+	 if (end > line && end[-1] != '\n' && !feof( in ))
+	    err_fatal( __func__, "Request %lu is too long\n", lineNumber );
+
+	 sizeText  = dict_batch_word( line, &end );
+	 startText = dict_batch_word( line, &end );
+	 while (end > line && isspace( (unsigned char) end[-1] ))
+	    --end;
+	 *end = '\0';
+
+	 if (*line || *startText || *sizeText) {
+	    r = &b.requests[b.count];
+	    if (!*line
+		|| !dict_batch_number( startText, base64, &r->start )
+		|| !dict_batch_number( sizeText, base64, &r->size ))
+	       err_fatal( __func__, "Malformed request on line %lu\n",
+			  lineNumber );
+
+	    r->file = dict_batch_file( &b, line );
+	    h       = b.files[r->file].data;
+	    if (r->start > h->length)
+	       r->start = h->length;
+	    if (r->size > h->length - r->start)
+	       r->size = h->length - r->start;
+	    b.bytes += r->size;
+	    ++b.count;
+	 }
+      }
+
+      if (b.count && (eof || b.count == DICT_BATCH_REQUESTS
+		      || b.bytes >= DICT_BATCH_BYTES))
+	 dict_batch_flush( &b, out, delimiter, delimiterLength );
+      if (eof)
+	 break;
+   }
+   if (ferror( in ))
+      err_fatal_errno( __func__, "Cannot read requests\n" );
+
+   for (i = 0; i < b.fileCount; i++) {
+      dict_data_close( b.files[i].data );
+      xfree( b.files[i].name );
+   }
+   if (b.files)
+      xfree( b.files );
+   xfree( b.requests );
+   xfree( b.sorted );
+   xfree( b.reads );
+   return 0;
+}
@@ -0,0 +1,47 @@
+/* batch.h -- Extract many ranges in one run
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <stdio.h>
+
+/* dictzip -B reads one request per line:
+
+      file start size
+
+   Start and size are decimal, or with |base64| in the base 64 of .index
+   files; the file name is whatever comes before them.  Ranges are
+   clipped to the end of the text and written to |out| in the order of
+   the requests, each after its length and a newline, or followed by
+   the |delimiterLength| bytes of |delimiter| if that is not NULL.
+
+   Requests are taken DICT_BATCH_REQUESTS, or DICT_BATCH_BYTES of text,
+   at a time.  Within a batch they are read in file order, every file
+   is opened once for the whole run, and ranges that share or nearly
+   share chunks are read together, so each chunk is inflated once per
+   batch.  Returns 0 on success. */
+
+#define DICT_BATCH_REQUESTS 4096
+#define DICT_BATCH_BYTES    (64L << 20)
+#define DICT_BATCH_SPAN     (4L << 20)	/* longest read of joined ranges */
+
+extern int dict_batch (
+   FILE *in, FILE *out, int base64,
+   const char *delimiter, int delimiterLength );
+
+#endif /* _BATCH_H_ */
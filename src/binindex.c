@@ -0,0 +1,703 @@
+/* binindex.c -- Compiled binary sidecars for dictd .index files
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "index.h"
+#include "binindex.h"
+#include "mph.h"
+#include "trie.h"
+#include "suffix.h"
+#include "fuzzy.h"
+#include "front.h"
+#include "bloom.h"
+
+#include <sys/stat.h>
+
+int compact_mode = 0; /* write FRNT instead of the lookup sections */
+
+unsigned long dict_bin_u32( const unsigned char *pt )
+{
+   return (unsigned long) pt[0]
+      | ((unsigned long) pt[1] << 8)
+      | ((unsigned long) pt[2] << 16)
+      | ((unsigned long) pt[3] << 24);
+}
+
+void dict_bin_put_u32( unsigned char *pt, unsigned long val )
+{
+   pt[0] = (unsigned char) (val & 0xff);
+   pt[1] = (unsigned char) ((val >> 8) & 0xff);
+   pt[2] = (unsigned char) ((val >> 16) & 0xff);
+   pt[3] = (unsigned char) ((val >> 24) & 0xff);
+}
+
+#define DICT_BIN_ALIGN(x) (((x) + 3) & ~3UL)
+
+/* A section being assembled by dict_bin_write(). */
+typedef struct dictBinSection {
+   char          id[4];
+   unsigned char *data;
+   unsigned long length;
+} dictBinSection;
+
+#define DICT_BIN_MAX_SECTIONS 16
+
+static void dict_bin_add_section(
+   dictBinSection *sections, int *count,
+   const char *id, unsigned char *data, unsigned long length )
+{
+   if (*count >= DICT_BIN_MAX_SECTIONS)
+      err_internal( __func__, "Too many sections\n" );
+   memcpy( sections[*count].id, id, 4 );
+   sections[*count].data   = data;
+   sections[*count].length = length;
+   ++*count;
+}
+
+int dict_index_entry_compare( const void *a, const void *b )
+{
+   const dictIndexEntry *x = a;
+   const dictIndexEntry *y = b;
+   int                  cmp;
+
+   if ((cmp = strcmp( x->key, y->key )))
+      return cmp;
+   return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/* KEYS: count, { blob offset, length }[count], then the normalized
+   keys, NUL-terminated.  Records with the same key share its copy. */
+static unsigned char *dict_bin_keys_build(
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length )
+{
+   unsigned long blobLength = 0;
+   unsigned long offset     = 0;
+   unsigned long len        = 0;
+   unsigned long i;
+   unsigned char *section;
+   unsigned char *pt;
+   unsigned char *blob;
+
+   for (i = 0; i < count; i++)
+      if (!i || strcmp( entries[i - 1].key, entries[i].key ))
+	 blobLength += strlen( entries[i].key ) + 1;
+
+   *length = 4 + count * DICT_BIN_KEY_SIZE + blobLength;
+   section = xmalloc( *length + 1 );
+   dict_bin_put_u32( section, count );
+   pt   = section + 4;
+   blob = pt + count * DICT_BIN_KEY_SIZE;
+   for (i = 0; i < count; i++, pt += DICT_BIN_KEY_SIZE) {
+      if (!i || strcmp( entries[i - 1].key, entries[i].key )) {
+	 offset += i ? len + 1 : 0;
+	 len     = strlen( entries[i].key );
+	 memcpy( blob + offset, entries[i].key, len + 1 );
+      }
+      dict_bin_put_u32( pt,     offset );
+      dict_bin_put_u32( pt + 4, len );
+   }
+   return section;
+}
+
+int dict_bin_write(
+   const char *filename, const char *source,
+   const dictIndex *index,
+   const dictIndexEntry *entries, unsigned long count )
+{
+   dictBinSection sections[DICT_BIN_MAX_SECTIONS];
+   int            sectionCount = 0;
+   unsigned char  header[DICT_BIN_HEADER_SIZE];
+   unsigned char  entry[DICT_BIN_SECTION_SIZE];
+   static const unsigned char pad[4];
+   unsigned char  *recs;
+   unsigned char  *strs;
+   unsigned long  strsLength = 0;
+   unsigned char  *keys;
+   unsigned long  keysLength;
+   unsigned char  *mph;
+   unsigned long  mphLength;
+   unsigned char  *trie;
+   unsigned long  trieLength;
+   unsigned char  *sufa;
+   unsigned long  sufaLength;
+   unsigned char  *front;
+   unsigned long  frontLength;
+   unsigned char  *bloom;
+   unsigned long  bloomLength;
+   unsigned long  offset;
+   unsigned long  flags = 0;
+   unsigned long  i;
+   struct stat    sb;
+   FILE           *str;
+   int            s;
+
+   if (stat( source, &sb ))
+      err_fatal_errno( __func__, "Cannot stat %s\n", source );
+
+				/* first, so that rejecting a word only
+                                   touches the start of the file */
+   bloom = dict_bloom_build( entries, count, &bloomLength );
+   dict_bin_add_section( sections, &sectionCount, "BLOM", bloom, bloomLength );
+
+   if (compact_mode) {
+      front = dict_front_build( entries, count, &frontLength );
+      dict_bin_add_section( sections, &sectionCount, "FRNT",
+			    front, frontLength );
+      goto header;
+   }
+
+   for (i = 0; i < count; i++)
+      strsLength += strlen( entries[i].word ) + 1;
+
+   recs = xmalloc( count * DICT_BIN_RECORD_SIZE + 1 );
+   strs = xmalloc( strsLength + 1 );
+   for (offset = i = 0; i < count; i++) {
+      unsigned char *rec = recs + i * DICT_BIN_RECORD_SIZE;
+      unsigned long len  = strlen( entries[i].word ) + 1;
+
+      dict_bin_put_u32( rec,     offset );
+      dict_bin_put_u32( rec + 4, entries[i].start );
+      dict_bin_put_u32( rec + 8, entries[i].size );
+      memcpy( strs + offset, entries[i].word, len );
+      offset += len;
+   }
+   dict_bin_add_section( sections, &sectionCount, "RECS",
+			 recs, count * DICT_BIN_RECORD_SIZE );
+   dict_bin_add_section( sections, &sectionCount, "STRS",
+			 strs, strsLength );
+   keys = dict_bin_keys_build( entries, count, &keysLength );
+   dict_bin_add_section( sections, &sectionCount, "KEYS", keys, keysLength );
+   if ((mph = dict_mph_build( entries, count, &mphLength )))
+      dict_bin_add_section( sections, &sectionCount, "MPHF",
+			    mph, mphLength );
+   trie = dict_trie_build( entries, count, &trieLength );
+   dict_bin_add_section( sections, &sectionCount, "TRIE", trie, trieLength );
+   sufa = dict_sufa_build( index, entries, count, &sufaLength );
+   dict_bin_add_section( sections, &sectionCount, "SUFA", sufa, sufaLength );
+
+ header:
+   if (index->flag_utf8)          flags |= DICT_BIN_UTF8;
+   if (index->flag_8bit)          flags |= DICT_BIN_8BIT;
+   if (index->flag_allchars)      flags |= DICT_BIN_ALLCHARS;
+   if (index->flag_casesensitive) flags |= DICT_BIN_CASESENSITIVE;
+
+   memcpy( header, DICT_BIN_MAGIC, 4 );
+   dict_bin_put_u32( header + 4,  DICT_BIN_VERSION );
+   dict_bin_put_u32( header + 8,  flags );
+   dict_bin_put_u32( header + 12, count );
+   dict_bin_put_u32( header + 16, (unsigned long) sb.st_size );
+   dict_bin_put_u32( header + 20, (unsigned long) sb.st_mtime );
+   dict_bin_put_u32( header + 24, sectionCount );
+
+   if (!(str = fopen( filename, "wb" )))
+      err_fatal_errno( __func__, "Cannot open %s for write\n", filename );
+
+   fwrite( header, 1, DICT_BIN_HEADER_SIZE, str );
+   offset = DICT_BIN_HEADER_SIZE + sectionCount * DICT_BIN_SECTION_SIZE;
+   for (s = 0; s < sectionCount; s++) {
+      memcpy( entry, sections[s].id, 4 );
+      dict_bin_put_u32( entry + 4, offset );
+      dict_bin_put_u32( entry + 8, sections[s].length );
+      fwrite( entry, 1, DICT_BIN_SECTION_SIZE, str );
+      offset = DICT_BIN_ALIGN( offset + sections[s].length );
+   }
+   for (s = 0; s < sectionCount; s++) {
+      fwrite( sections[s].data, 1, sections[s].length, str );
+      fwrite( pad, 1,
+	      DICT_BIN_ALIGN( sections[s].length ) - sections[s].length, str );
+      xfree( sections[s].data );
+   }
+
+   if (fflush( str ) || ferror( str )) {
+      err_warning( __func__, "Cannot write %s\n", filename );
+      fclose( str );
+      unlink( filename );
+      return 1;
+   }
+   fclose( str );
+
+   PRINTF(DBG_INIT,("%s: %lu headwords, %d sections\n",
+		    filename, count, sectionCount));
+   return 0;
+}
+
+const unsigned char *dict_bin_section(
+   const dictBinIndex *bin, const char *id, unsigned long *length )
+{
+   const unsigned char *entry;
+   unsigned long       i;
+
+   for (i = 0; i < bin->sections; i++) {
+      entry = bin->table + i * DICT_BIN_SECTION_SIZE;
+      if (!memcmp( entry, id, 4 )) {
+	 if (length)
+	    *length = dict_bin_u32( entry + 8 );
+	 return (const unsigned char *) bin->start + dict_bin_u32( entry + 4 );
+      }
+   }
+   return NULL;
+}
+
+/* Check that the header and section table of a freshly mapped sidecar
+   describe a file of |bin->size| bytes. */
+static int dict_bin_valid( const dictBinIndex *bin, unsigned long headwords )
+{
+   const unsigned char *entry;
+   unsigned long       i, offset, length;
+
+   if (bin->sections > DICT_BIN_MAX_SECTIONS
+       || DICT_BIN_HEADER_SIZE + bin->sections * DICT_BIN_SECTION_SIZE
+          > bin->size)
+      return 0;
+   for (i = 0; i < bin->sections; i++) {
+      entry  = bin->table + i * DICT_BIN_SECTION_SIZE;
+      offset = dict_bin_u32( entry + 4 );
+      length = dict_bin_u32( entry + 8 );
+      if (offset > bin->size || length > bin->size - offset)
+	 return 0;
+   }
+				/* compact sidecars have FRNT instead */
+   if ((entry = dict_bin_section( bin, "FRNT", &length ))
+       && !dict_bin_section( bin, "RECS", NULL ))
+      return dict_front_valid( entry, length, headwords );
+   if (!dict_bin_section( bin, "RECS", &length )
+       || length != headwords * DICT_BIN_RECORD_SIZE
+       || !(entry = dict_bin_section( bin, "STRS", &length ))
+       || (length && entry[length - 1]))
+      return 0;
+   return 1;
+}
+
+int dict_bin_open( dictIndex *index, const char *filename )
+{
+   dictBinIndex        *bin;
+   const unsigned char *pt;
+   char                *binFilename;
+   struct stat         sb, source;
+   int                 haveSource;
+   unsigned long       flags, headwords, length;
+
+   binFilename = xmalloc( strlen( filename ) + sizeof( DICT_BIN_SUFFIX ) );
+   strcpy( binFilename, filename );
+   strcat( binFilename, DICT_BIN_SUFFIX );
+
+   if (stat( binFilename, &sb ) || sb.st_size < DICT_BIN_HEADER_SIZE) {
+      xfree( binFilename );
+      return 0;
+   }
+
+   bin = xmalloc( sizeof( dictBinIndex ) );
+   memset( bin, 0, sizeof( dictBinIndex ) );
+   bin->start = dict_index_map_file( binFilename, &bin->fd, &bin->size );
+   pt         = (const unsigned char *) bin->start;
+   if (bin->size < DICT_BIN_HEADER_SIZE) {
+      err_warning( __func__, "Ignoring truncated %s\n", binFilename );
+      goto fail;
+   }
+
+   flags         = dict_bin_u32( pt + 8 );
+   headwords     = dict_bin_u32( pt + 12 );
+   bin->sections = dict_bin_u32( pt + 24 );
+   bin->table    = pt + DICT_BIN_HEADER_SIZE;
+
+				/* A sidecar without its .index is used
+                                   as is; otherwise it has to match. */
+   haveSource = !stat( filename, &source );
+   if (memcmp( pt, DICT_BIN_MAGIC, 4 )
+       || dict_bin_u32( pt + 4 ) != DICT_BIN_VERSION
+       || !dict_bin_valid( bin, headwords ))
+   {
+      err_warning( __func__, "Ignoring malformed %s\n", binFilename );
+      goto fail;
+   }
+   if (haveSource
+       && (dict_bin_u32( pt + 16 ) != (unsigned long) source.st_size
+	   || dict_bin_u32( pt + 20 ) != ((unsigned long) source.st_mtime
+					  & 0xffffffffUL)))
+   {
+      PRINTF(DBG_INIT,("%s: stale, using %s\n", binFilename, filename));
+      goto fail;
+   }
+
+   if ((bin->bloom = dict_bin_section( bin, "BLOM", &length ))
+       && !dict_bloom_valid( bin->bloom, length ))
+   {
+      err_warning( __func__, "Ignoring malformed filter in %s\n",
+		   binFilename );
+      bin->bloom = NULL;
+   }
+   if (!(bin->recs = dict_bin_section( bin, "RECS", NULL ))) {
+      bin->front = dict_bin_section( bin, "FRNT", NULL );
+      goto done;
+   }
+   bin->strs = (const char *) dict_bin_section( bin, "STRS",
+						&bin->strsLength );
+   if ((bin->keys = dict_bin_section( bin, "KEYS", &length ))) {
+      if (length < 4 + headwords * DICT_BIN_KEY_SIZE
+	  || dict_bin_u32( bin->keys ) != headwords
+	  || (length > 4 + headwords * DICT_BIN_KEY_SIZE
+	      && bin->keys[length - 1]))
+      {
+	 err_warning( __func__, "Ignoring malformed keys in %s\n",
+		      binFilename );
+	 bin->keys = NULL;
+      } else {
+	 bin->keyBlob       = (const char *) bin->keys + 4
+			      + headwords * DICT_BIN_KEY_SIZE;
+	 bin->keyBlobLength = length - 4 - headwords * DICT_BIN_KEY_SIZE;
+      }
+   }
+   if ((bin->mph = dict_bin_section( bin, "MPHF", &length ))
+       && !dict_mph_valid( bin->mph, length, headwords ))
+   {
+      err_warning( __func__, "Ignoring malformed hash in %s\n", binFilename );
+      bin->mph = NULL;
+   }
+   if ((bin->trie = dict_bin_section( bin, "TRIE", &length ))
+       && !dict_trie_valid( bin->trie, length ))
+   {
+      err_warning( __func__, "Ignoring malformed trie in %s\n", binFilename );
+      bin->trie = NULL;
+   }
+   if ((bin->sufa = dict_bin_section( bin, "SUFA", &length ))
+       && !dict_sufa_valid( bin->sufa, length, headwords ))
+   {
+      err_warning( __func__, "Ignoring malformed suffix array in %s\n",
+		   binFilename );
+      bin->sufa = NULL;
+   }
+
+ done:
+   index->bin                = bin;
+   index->headwords          = headwords;
+   index->flag_utf8          = (flags & DICT_BIN_UTF8) != 0;
+   index->flag_8bit          = (flags & DICT_BIN_8BIT) != 0;
+   index->flag_allchars      = (flags & DICT_BIN_ALLCHARS) != 0;
+   index->flag_casesensitive = (flags & DICT_BIN_CASESENSITIVE) != 0;
+   dict_index_set_flags( index );
+
+   xfree( binFilename );
+   return 1;
+
+ fail:
+   dict_index_unmap_file( bin->start, bin->size, bin->fd );
+   xfree( bin );
+   xfree( binFilename );
+   return 0;
+}
+
+void dict_bin_close( dictIndex *index )
+{
+   dictBinIndex *bin = index->bin;
+
+   if (!bin)
+      return;
+   dict_index_unmap_file( bin->start, bin->size, bin->fd );
+   xfree( bin );
+   index->bin = NULL;
+}
+
+static const char *dict_bin_word( const dictBinIndex *bin, unsigned long i )
+{
+   unsigned long offset = dict_bin_u32( bin->recs + i * DICT_BIN_RECORD_SIZE );
+
+   return offset < bin->strsLength ? bin->strs + offset : "";
+}
+
+/* The normalized headword of record |i| and its length: straight from
+   KEYS, or normalized into |buffer| (BUFFERSIZE bytes) for a sidecar
+   without them. */
+static const char *dict_bin_key(
+   const dictIndex *index, unsigned long i, char *buffer, int *len )
+{
+   const dictBinIndex  *bin = index->bin;
+   const unsigned char *pt;
+   const char          *word;
+   unsigned long       offset, length;
+
+   if (bin->keys) {
+      pt     = bin->keys + 4 + i * DICT_BIN_KEY_SIZE;
+      offset = dict_bin_u32( pt );
+      length = dict_bin_u32( pt + 4 );
+      if (offset > bin->keyBlobLength
+	  || length >= bin->keyBlobLength - offset)
+      {
+	 *len = 0;
+	 return "";
+      }
+      *len = (int) length;
+      return bin->keyBlob + offset;
+   }
+
+   word = dict_bin_word( bin, i );
+   *len = dict_index_normalize( index, word, (int) strlen( word ),
+				buffer, BUFFERSIZE );
+   return buffer;
+}
+
+/* Compare the normalized |key| with the headword of record |i|, as
+   dict_index_compare() does for a line of the text index.  With KEYS
+   this is a single memcmp(). */
+static int dict_bin_compare(
+   const dictIndex *index, const char *key, int keyLength,
+   unsigned long i, int prefix )
+{
+   char       buffer[BUFFERSIZE];
+   const char *stored;
+   int        len, cmp;
+
+   stored = dict_bin_key( index, i, buffer, &len );
+   if ((cmp = memcmp( key, stored, keyLength < len ? keyLength : len )))
+      return cmp;
+   if (prefix)
+      return keyLength > len;
+   return keyLength < len ? -1 : keyLength > len;
+}
+
+/* Fill |dw| from record |i|.  The headword is left in the mapping. */
+static void dict_bin_fill(
+   const dictBinIndex *bin, unsigned long i, dictWord *dw )
+{
+   const unsigned char *rec = bin->recs + i * DICT_BIN_RECORD_SIZE;
+
+   memset( dw, 0, sizeof( dictWord ) );
+   dw->word     = (char *) dict_bin_word( bin, i );
+   dw->start    = dict_bin_u32( rec + 4 );
+   dw->end      = dict_bin_u32( rec + 8 );
+   dw->def_size = -1;
+}
+
+/* Find the records [|lo|, |hi|) matching |key|, using the hash for
+   exact matches and the trie for prefixes when the sidecar has them. */
+static void dict_bin_range(
+   const dictIndex *index,
+   const char *key, int keyLength, int prefix,
+   unsigned long *lo, unsigned long *hi )
+{
+   const dictBinIndex *bin = index->bin;
+   unsigned long      l    = 0;
+   unsigned long      h    = index->headwords;
+   unsigned long      mid, n;
+
+   *lo = *hi = 0;
+				/* One probe instead of a binary search;
+                                   the hash only says where the word would
+                                   be, so check that it is there. */
+   if (!prefix && bin->mph) {
+      if (dict_mph_lookup( bin->mph, key, keyLength, &l, &n )
+	  && l < index->headwords && n <= index->headwords - l
+	  && !dict_bin_compare( index, key, keyLength, l, 0 ))
+      {
+	 *lo = l;
+	 *hi = l + n;
+      }
+      return;
+   }
+   if (prefix && bin->trie) {
+      dict_trie_range( bin->trie, index->headwords, key, keyLength, lo, hi );
+      return;
+   }
+
+   while (l < h) {
+      mid = l + (h - l) / 2;
+      if (dict_bin_compare( index, key, keyLength, mid, prefix ) > 0)
+	 l = mid + 1;
+      else
+	 h = mid;
+   }
+   for (*lo = *hi = l;
+	*hi < index->headwords
+	   && !dict_bin_compare( index, key, keyLength, *hi, prefix );
+	++*hi)
+      ;
+}
+
+/* Hand records [|lo|, |hi|) to the caller's callback, up to its limit.
+   Shared by the suffix array and trie paths, which find matches in
+   runs. */
+typedef struct dictBinEmit {
+   const dictBinIndex *bin;
+   unsigned long      max;
+   unsigned long      count;
+   dictIndexCallback  callback;
+   void               *arg;
+} dictBinEmit;
+
+static int dict_bin_emit( unsigned long lo, unsigned long hi, void *arg )
+{
+   dictBinEmit *emit = arg;
+   dictWord    dw;
+
+   for (; lo < hi && emit->count < emit->max; lo++) {
+      dict_bin_fill( emit->bin, lo, &dw );
+      ++emit->count;
+      if (emit->callback( &dw, emit->arg ))
+	 return 1;
+   }
+   return emit->count >= emit->max;
+}
+
+/* The linear fallback for a sidecar without the section a strategy
+   would use. */
+static unsigned long dict_bin_scan(
+   const dictIndex *index,
+   const char *key, int keyLength, int strategy, dictFuzzy *fuzzy,
+   unsigned long max, dictIndexCallback callback, void *arg )
+{
+   const dictBinIndex *bin = index->bin;
+   char               buffer[BUFFERSIZE];
+   const char         *stored;
+   unsigned long      i, count = 0;
+   int                len;
+   dictWord           dw;
+
+   for (i = 0; i < index->headwords && count < max; i++) {
+      stored = dict_bin_key( index, i, buffer, &len );
+      if (!dict_index_match_key( key, keyLength, stored, len,
+				 strategy, fuzzy ))
+	 continue;
+      dict_bin_fill( bin, i, &dw );
+      ++count;
+      if (callback( &dw, arg ))
+	 break;
+   }
+   return count;
+}
+
+/* dict_bin_enumerate() for a compact sidecar.  Exact and prefix
+   matches seek to the first candidate and stop at the first record past
+   them; the other strategies decode every record. */
+static unsigned long dict_bin_front_enumerate(
+   const dictIndex *index,
+   const char *key, int keyLength, int strategy, int distance,
+   unsigned long max, dictIndexCallback callback, void *arg )
+{
+   const unsigned char *front = index->bin->front;
+   dictFrontCursor     *cursor;
+   dictFuzzy           fuzzy;
+   dictFuzzy           *f     = NULL;
+   dictWord            dw;
+   unsigned long       count  = 0;
+   int                 seek, ok;
+
+   if (strategy == DICT_STRAT_LEVENSHTEIN) {
+      if (!dict_fuzzy_init( &fuzzy, index, key, keyLength, distance ))
+	 return 0;
+      f = &fuzzy;
+   }
+   seek = !f && !(keyLength && (strategy == DICT_STRAT_SUBSTRING
+				|| strategy == DICT_STRAT_SUFFIX));
+
+   cursor = xmalloc( sizeof( dictFrontCursor ) );
+   if (seek)
+      ok = dict_front_seek( front, key, keyLength, cursor );
+   else {
+      dict_front_rewind( cursor );
+      ok = dict_front_next( front, cursor );
+   }
+   for (; ok && count < max; ok = dict_front_next( front, cursor )) {
+      if (seek) {
+	 if (cursor->keyLength < keyLength
+	     || (strategy == DICT_STRAT_EXACT
+		 && cursor->keyLength != keyLength)
+	     || memcmp( cursor->key, key, keyLength ))
+	    break;
+      } else if (!dict_index_match_key( key, keyLength,
+				       cursor->key, cursor->keyLength,
+				       strategy, f ))
+	 continue;
+
+      memset( &dw, 0, sizeof( dictWord ) );
+      dw.word     = cursor->word;
+      dw.start    = cursor->start;
+      dw.end      = cursor->size;
+      dw.def_size = -1;
+      ++count;
+      if (callback( &dw, arg ))
+	 break;
+   }
+
+   xfree( cursor );
+   if (f)
+      dict_fuzzy_free( f );
+   return count;
+}
+
+unsigned long dict_bin_enumerate(
+   const dictIndex *index,
+   const char *key, int keyLength, int strategy, int distance,
+   unsigned long max, dictIndexCallback callback, void *arg )
+{
+   const dictBinIndex *bin = index->bin;
+   unsigned long      *keys;
+   unsigned long      lo, hi, n, k;
+   dictBinEmit        emit;
+   dictFuzzy          fuzzy;
+
+   emit.bin      = bin;
+   emit.max      = max;
+   emit.count    = 0;
+   emit.callback = callback;
+   emit.arg      = arg;
+   if (!max)
+      return 0;
+   if (strategy == DICT_STRAT_EXACT && bin->bloom
+       && !dict_bloom_contains( bin->bloom, key, keyLength ))
+      return 0;
+   if (bin->front)
+      return dict_bin_front_enumerate( index, key, keyLength, strategy,
+				       distance, max, callback, arg );
+
+   if (strategy == DICT_STRAT_LEVENSHTEIN) {
+      if (!dict_fuzzy_init( &fuzzy, index, key, keyLength, distance ))
+	 return 0;
+      if (bin->trie)
+	 dict_fuzzy_trie( &fuzzy, bin->trie, index->headwords,
+			  dict_bin_emit, &emit );
+      else
+	 emit.count = dict_bin_scan( index, key, keyLength, strategy, &fuzzy,
+				     max, callback, arg );
+      dict_fuzzy_free( &fuzzy );
+      return emit.count;
+   }
+
+   if (keyLength
+       && (strategy == DICT_STRAT_SUBSTRING || strategy == DICT_STRAT_SUFFIX))
+   {
+      if (!bin->sufa)
+	 return dict_bin_scan( index, key, keyLength, strategy, NULL,
+			       max, callback, arg );
+      n = dict_sufa_search( bin->sufa, key, keyLength,
+			    strategy == DICT_STRAT_SUFFIX, &keys );
+      for (k = 0; k < n; k++) {
+	 dict_sufa_records( bin->sufa, index->headwords, keys[k], &lo, &hi );
+	 if (dict_bin_emit( lo, hi, &emit ))
+	    break;
+      }
+      if (keys)
+	 xfree( keys );
+      return emit.count;
+   }
+
+				/* an empty substring or suffix matches
+                                   everything, as an empty prefix does */
+   dict_bin_range( index, key, keyLength, strategy != DICT_STRAT_EXACT,
+		   &lo, &hi );
+   dict_bin_emit( lo, hi, &emit );
+   return emit.count;
+}
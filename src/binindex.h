@@ -0,0 +1,133 @@
+/* binindex.h -- Compiled binary sidecars for dictd .index files
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _BININDEX_H_
+#define _BININDEX_H_
+
+#include "defs.h"
+#include "index.h"
+
+/* A sidecar "foo.index.bin" holds everything dict_search_index() needs
+   from "foo.index" in a form that is used straight from the mapping:
+
+      header    "DZIX", version, flags, headwords, size and mtime of
+                the .index it was compiled from, number of sections
+      sections  { 4-byte id, offset, length } for each section
+      RECS      headwords records { STRS offset, start, size }, in
+                index order
+      STRS      the headwords as they appear in the .index, each
+                NUL-terminated
+      KEYS      the headwords as dict_index_normalize() leaves them, so
+                that comparing with a query is a plain memcmp()
+      MPHF      perfect hash for exact matches (see mph.h)
+      TRIE      radix trie for prefix matches (see trie.h)
+      SUFA      suffix array for substring and suffix matches (see
+                suffix.h)
+      BLOM      Bloom filter that rules out most absent words (see
+                bloom.h)
+
+   A compact sidecar has only FRNT (see front.h), which holds the
+   records, headwords and keys front-coded in blocks, in a fraction of
+   the space of the .index.  Lookups decode it in place.
+
+   All numbers are little-endian 32-bit and every section starts on a
+   4-byte boundary.  Readers skip sections they do not know. */
+
+#define DICT_BIN_SUFFIX        ".bin"
+#define DICT_BIN_MAGIC         "DZIX"
+#define DICT_BIN_VERSION       1
+
+#define DICT_BIN_UTF8          0x01
+#define DICT_BIN_8BIT          0x02
+#define DICT_BIN_ALLCHARS      0x04
+#define DICT_BIN_CASESENSITIVE 0x08
+
+#define DICT_BIN_HEADER_SIZE   28
+#define DICT_BIN_SECTION_SIZE  12
+#define DICT_BIN_RECORD_SIZE   12
+#define DICT_BIN_KEY_SIZE      8
+
+typedef struct dictBinIndex {
+   int                 fd;
+   const char          *start;	/* start of the mapping */
+   unsigned long       size;	/* size of the mapping */
+   unsigned long       sections;
+   const unsigned char *table;	/* section table */
+   const unsigned char *recs;	/* RECS section */
+   const char          *strs;	/* STRS section */
+   unsigned long       strsLength;
+   const unsigned char *keys;	/* KEYS section, if present */
+   const char          *keyBlob;
+   unsigned long       keyBlobLength;
+   const unsigned char *mph;	/* MPHF section, if present */
+   const unsigned char *trie;	/* TRIE section, if present */
+   const unsigned char *sufa;	/* SUFA section, if present */
+   const unsigned char *front;	/* FRNT section of a compact sidecar */
+   const unsigned char *bloom;	/* BLOM section, if present */
+} dictBinIndex;
+
+/* One headword on its way into a sidecar.  |key| is the headword as
+   normalized by dict_index_normalize(); |order| keeps sorting stable. */
+typedef struct dictIndexEntry {
+   const char    *word;
+   const char    *key;
+   unsigned long start;
+   unsigned long size;
+   unsigned long order;
+} dictIndexEntry;
+
+/* qsort() comparator putting entries in sidecar order: by key, then by
+   |order| */
+extern int dict_index_entry_compare (
+   const void *a, const void *b );
+
+/* little-endian 32-bit fields of the sidecar */
+extern unsigned long dict_bin_u32 (
+   const unsigned char *pt );
+extern void dict_bin_put_u32 (
+   unsigned char *pt, unsigned long val );
+
+/* write compact sidecars, with FRNT in place of the other sections */
+extern int compact_mode;
+
+/* Write the |count| sorted |entries| of |index| (which supplies the
+   flags) to |filename|, recording the size and mtime of |source| so
+   that a stale sidecar is noticed.  Returns 0 on success. */
+extern int dict_bin_write (
+   const char *filename, const char *source,
+   const dictIndex *index,
+   const dictIndexEntry *entries, unsigned long count );
+
+/* Map the sidecar of the .index |filename| into |index| if there is one
+   and it is up to date.  Returns 0, leaving |index| alone, if not. */
+extern int dict_bin_open (
+   dictIndex *index, const char *filename );
+extern void dict_bin_close (
+   dictIndex *index );
+
+/* locate section |id|, returning NULL if the sidecar has none */
+extern const unsigned char *dict_bin_section (
+   const dictBinIndex *bin, const char *id, unsigned long *length );
+
+/* dict_index_enumerate() for a compiled index; |key| is already
+   normalized and |distance| only matters to DICT_STRAT_LEVENSHTEIN. */
+extern unsigned long dict_bin_enumerate (
+   const dictIndex *index,
+   const char *key, int keyLength, int strategy, int distance,
+   unsigned long max, dictIndexCallback callback, void *arg );
+
+#endif /* _BININDEX_H_ */
@@ -0,0 +1,128 @@
+/* bloom.c -- Bloom filter over normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "bloom.h"
+
+#define DICT_BLOOM_MASK 0xffffffffUL
+
+static unsigned long dict_bloom_mix( unsigned long h )
+{
+   h &= DICT_BLOOM_MASK;
+   h ^= h >> 16;
+   h  = (h * 0x85ebca6bUL) & DICT_BLOOM_MASK;
+   h ^= h >> 13;
+   h  = (h * 0xc2b2ae35UL) & DICT_BLOOM_MASK;
+   h ^= h >> 16;
+   return h;
+}
+
+/* h[0] picks the block, h[1] and h[2] the bits within it */
+static void dict_bloom_hash( const char *key, int len, unsigned long *h )
+{
+   unsigned long a = 2166136261UL;
+   unsigned long b = (unsigned long) len;
+   unsigned long c;
+   int           i;
+
+   for (i = 0; i < len; i++) {
+      c = (unsigned char) key[i];
+      a = ((a ^ c) * 16777619UL) & DICT_BLOOM_MASK;
+      b = ((((b << 5) | (b >> 27)) ^ c) * 0x27d4eb2dUL) & DICT_BLOOM_MASK;
+   }
+   h[0] = dict_bloom_mix( a );
+   h[1] = dict_bloom_mix( b ^ 0x5bd1e995UL );
+   h[2] = dict_bloom_mix( a + b ) | 1;
+}
+
+/* bit |i| of the key's block */
+#define DICT_BLOOM_BIT(h, i) \
+   (((h)[1] + (unsigned long) (i) * (h)[2]) & (8 * DICT_BLOOM_BLOCK - 1))
+
+unsigned char *dict_bloom_build(
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length )
+{
+   unsigned long keys = 0;
+   unsigned long blocks, bit, i;
+   unsigned long h[3];
+   unsigned char *section;
+   unsigned char *block;
+   int           k;
+
+   for (i = 0; i < count; i++)
+      if (!i || strcmp( entries[i - 1].key, entries[i].key ))
+	 ++keys;
+   blocks = (keys * DICT_BLOOM_BITS + 8 * DICT_BLOOM_BLOCK - 1)
+	    / (8 * DICT_BLOOM_BLOCK);
+   if (!blocks)
+      blocks = 1;
+
+   *length = DICT_BLOOM_HEADER_SIZE + blocks * DICT_BLOOM_BLOCK;
+   section = xmalloc( *length + 1 );
+   memset( section, 0, *length );
+   dict_bin_put_u32( section,     keys );
+   dict_bin_put_u32( section + 4, blocks );
+   dict_bin_put_u32( section + 8, DICT_BLOOM_HASHES );
+
+   for (i = 0; i < count; i++) {
+      if (i && !strcmp( entries[i - 1].key, entries[i].key ))
+	 continue;
+      dict_bloom_hash( entries[i].key, (int) strlen( entries[i].key ), h );
+      block = section + DICT_BLOOM_HEADER_SIZE
+	      + (h[0] % blocks) * DICT_BLOOM_BLOCK;
+      for (k = 0; k < DICT_BLOOM_HASHES; k++) {
+	 bit = DICT_BLOOM_BIT( h, k );
+	 block[bit >> 3] |= 1 << (bit & 7);
+      }
+   }
+
+   PRINTF(DBG_INIT,("%s: %lu keys in %lu blocks\n", __func__, keys, blocks));
+   return section;
+}
+
+int dict_bloom_valid( const unsigned char *bloom, unsigned long length )
+{
+   unsigned long blocks;
+
+   if (length < DICT_BLOOM_HEADER_SIZE)
+      return 0;
+   blocks = dict_bin_u32( bloom + 4 );
+   return blocks
+      && blocks <= (length - DICT_BLOOM_HEADER_SIZE) / DICT_BLOOM_BLOCK
+      && length == DICT_BLOOM_HEADER_SIZE + blocks * DICT_BLOOM_BLOCK
+      && dict_bin_u32( bloom + 8 ) <= 8 * DICT_BLOOM_BLOCK;
+}
+
+int dict_bloom_contains(
+   const unsigned char *bloom, const char *key, int keyLength )
+{
+   unsigned long       blocks = dict_bin_u32( bloom + 4 );
+   unsigned long       hashes = dict_bin_u32( bloom + 8 );
+   unsigned long       h[3];
+   unsigned long       bit, k;
+   const unsigned char *block;
+
+   dict_bloom_hash( key, keyLength, h );
+   block = bloom + DICT_BLOOM_HEADER_SIZE + (h[0] % blocks) * DICT_BLOOM_BLOCK;
+   for (k = 0; k < hashes; k++) {
+      bit = DICT_BLOOM_BIT( h, k );
+      if (!(block[bit >> 3] & (1 << (bit & 7))))
+	 return 0;
+   }
+   return 1;
+}
@@ -0,0 +1,52 @@
+/* bloom.h -- Bloom filter over normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _BLOOM_H_
+#define _BLOOM_H_
+
+#include "binindex.h"
+
+/* The BLOM section tells, without touching the rest of the sidecar,
+   that a word is certainly not in the index.  It is a blocked Bloom
+   filter: a key picks one 64-byte block and sets DICT_BLOOM_HASHES bits
+   in it, so a probe reads a single cache line.
+
+      keys, blocks, hashes
+      bits[blocks * 64]
+
+   With DICT_BLOOM_BITS bits per key about one absent word in a hundred
+   gets through. */
+
+#define DICT_BLOOM_HEADER_SIZE 12
+#define DICT_BLOOM_BLOCK       64	/* bytes */
+#define DICT_BLOOM_BITS        10	/* per key */
+#define DICT_BLOOM_HASHES      7
+
+/* Build the section for the |count| |entries|, which must be sorted by
+   key. */
+extern unsigned char *dict_bloom_build (
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length );
+
+extern int dict_bloom_valid (
+   const unsigned char *bloom, unsigned long length );
+
+/* 0 if the normalized |key| is certainly not in the index */
+extern int dict_bloom_contains (
+   const unsigned char *bloom, const char *key, int keyLength );
+
+#endif /* _BLOOM_H_ */
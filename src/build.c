@@ -0,0 +1,362 @@
+/* build.c -- Build dictd indexes from dictionary text
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "data.h"
+#include "index.h"
+#include "binindex.h"
+#include "build.h"
+#include "thread.h"
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DICT_BUILD_SSE2 1
+#endif
+
+#define DICT_BUILD_PIECE   (4 * 1024 * 1024) /* bytes read at a time */
+#define DICT_BUILD_SEGMENT (1024 * 1024)     /* least input per thread */
+
+/* One thread's share of the input.  Segments of dictzip files start on
+   chunk boundaries, so no chunk is inflated by two threads except to
+   look past the end of a segment. */
+typedef struct dictBuildScan {
+   const char     *filename;
+   unsigned long  from, to;
+   unsigned long  piece;
+   dictIndexEntry *entries;
+   unsigned long  count;
+   unsigned long  alloc;
+   dictThread     thread;
+} dictBuildScan;
+
+typedef struct dictBuildSort {
+   const dictIndex *index;
+   dictIndexEntry  *entries;
+   unsigned long   lo, hi;
+   dictThread      thread;
+} dictBuildSort;
+
+typedef struct dictBuildMerge {
+   const dictIndexEntry *src;
+   dictIndexEntry       *dest;
+   unsigned long        lo, mid, hi;
+   dictThread           thread;
+} dictBuildMerge;
+
+/* first newline in [|pt|, |end|), or NULL */
+static const char *dict_build_newline( const char *pt, const char *end )
+{
+#ifdef DICT_BUILD_SSE2
+   const __m128i nl = _mm_set1_epi8( '\n' );
+   int           mask;
+
+   for (; end - pt >= 16; pt += 16) {
+      mask = _mm_movemask_epi8(
+	 _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *) pt ), nl ) );
+      if (mask) {
+	 while (!(mask & 1)) {
+	    mask >>= 1;
+	    ++pt;
+	 }
+	 return pt;
+      }
+   }
+#endif
+   if (pt >= end)
+      return NULL;
+   return memchr( pt, '\n', end - pt );
+}
+
+/* Record the entry whose line starts at |line|, |offset| bytes into the
+   input, if the line starts one. */
+static void dict_build_line(
+   dictBuildScan *scan,
+   const char *line, const char *end, unsigned long offset )
+{
+   const char     *pt;
+   dictIndexEntry *entries;
+   char           *word;
+   int            len;
+
+   if (line >= end
+       || *line == ' ' || *line == '\t' || *line == '\r' || *line == '\n')
+      return;
+
+   for (pt = line;
+	pt < end && *pt != '\t' && *pt != '\n' && pt - line < BUFFERSIZE - 1;
+	pt++)
+      ;
+   for (len = (int) (pt - line);
+	len && (line[len - 1] == ' ' || line[len - 1] == '\r');
+	len--)
+      ;
+
+   if (scan->count == scan->alloc) {
+      scan->alloc = scan->alloc ? 2 * scan->alloc : 1024;
+      entries = xmalloc( scan->alloc * sizeof( dictIndexEntry ) );
+      if (scan->count)
+	 memcpy( entries, scan->entries,
+		 scan->count * sizeof( dictIndexEntry ) );
+      if (scan->entries)
+	 xfree( scan->entries );
+      scan->entries = entries;
+   }
+
+   word = xmalloc( len + 1 );
+   memcpy( word, line, len );
+   word[len] = '\0';
+   scan->entries[scan->count].word  = word;
+   scan->entries[scan->count].key   = NULL;
+   scan->entries[scan->count].start = offset;
+   scan->entries[scan->count].size  = 0;
+   ++scan->count;
+}
+
+/* Find the entries that start within a segment.  Each piece is read
+   together with the byte before it, to tell whether its first byte
+   starts a line, and BUFFERSIZE bytes after it, so that a headword
+   crossing the end is read whole. */
+static void dict_build_scan( void *arg )
+{
+   dictBuildScan *scan = arg;
+   dictData      *data = dict_data_open( scan->filename, 0 );
+   unsigned long pos, end, from, to;
+   char          *buf;
+   const char    *nl, *pt;
+
+   for (pos = scan->from; pos < scan->to; pos = end) {
+      end  = scan->to - pos > scan->piece ? pos + scan->piece : scan->to;
+      from = pos ? pos - 1 : 0;
+      to   = data->length - end > BUFFERSIZE ? end + BUFFERSIZE : data->length;
+      buf  = dict_data_read_( data, from, to - from, NULL, NULL );
+
+      if (!pos)
+	 dict_build_line( scan, buf, buf + (to - from), 0 );
+      for (pt = buf;
+	   (nl = dict_build_newline( pt, buf + (end - from) - 1 ));
+	   pt = nl + 1)
+	 dict_build_line( scan, nl + 1, buf + (to - from),
+			  from + (nl + 1 - buf) );
+      xfree( buf );
+   }
+   dict_data_close( data );
+}
+
+/* Normalize and sort one slice of the entries. */
+static void dict_build_sort( void *arg )
+{
+   dictBuildSort *sort = arg;
+   char          key[BUFFERSIZE];
+   unsigned long i;
+   int           len;
+
+   for (i = sort->lo; i < sort->hi; i++) {
+      len = dict_index_normalize( sort->index, sort->entries[i].word,
+				  (int) strlen( sort->entries[i].word ),
+				  key, sizeof( key ) );
+      sort->entries[i].key = memcpy( xmalloc( len + 1 ), key, len + 1 );
+   }
+   qsort( sort->entries + sort->lo, sort->hi - sort->lo,
+	  sizeof( dictIndexEntry ), dict_index_entry_compare );
+}
+
+static void dict_build_merge( void *arg )
+{
+   dictBuildMerge       *merge = arg;
+   const dictIndexEntry *src   = merge->src;
+   dictIndexEntry       *dest  = merge->dest + merge->lo;
+   unsigned long        i      = merge->lo;
+   unsigned long        j      = merge->mid;
+
+   while (i < merge->mid && j < merge->hi)
+      *dest++ = dict_index_entry_compare( src + j, src + i ) < 0
+	 ? src[j++] : src[i++];
+   while (i < merge->mid)
+      *dest++ = src[i++];
+   while (j < merge->hi)
+      *dest++ = src[j++];
+}
+
+/* Sort |entries| by key, a slice per thread, then merge the slices in
+   pairs until one run is left.  Returns the array the result is in. */
+static dictIndexEntry *dict_build_order(
+   const dictIndex *index,
+   dictIndexEntry *entries, unsigned long count, int threads )
+{
+   dictBuildSort  *sorts;
+   dictBuildMerge *merges;
+   dictIndexEntry *src = entries;
+   dictIndexEntry *dest;
+   dictIndexEntry *tmp;
+   unsigned long  *bounds;
+   unsigned long  runs, pairs, p;
+
+   runs = (unsigned long) threads < count ? (unsigned long) threads : count;
+   if (!runs)
+      runs = 1;
+   sorts  = xmalloc( runs * sizeof( dictBuildSort ) );
+   bounds = xmalloc( (runs + 1) * sizeof( unsigned long ) );
+   for (p = 0; p < runs; p++) {
+      sorts[p].index   = index;
+      sorts[p].entries = entries;
+      sorts[p].lo      = bounds[p] = count / runs * p;
+      sorts[p].hi      = p + 1 < runs ? count / runs * (p + 1) : count;
+      dict_thread_create( &sorts[p].thread, dict_build_sort, &sorts[p] );
+   }
+   bounds[runs] = count;
+   for (p = 0; p < runs; p++)
+      dict_thread_join( sorts[p].thread );
+   xfree( sorts );
+
+   dest   = xmalloc( (count + 1) * sizeof( dictIndexEntry ) );
+   merges = xmalloc( (runs / 2 + 1) * sizeof( dictBuildMerge ) );
+   while (runs > 1) {
+      pairs = runs / 2;
+      for (p = 0; p < pairs; p++) {
+	 merges[p].src  = src;
+	 merges[p].dest = dest;
+	 merges[p].lo   = bounds[2 * p];
+	 merges[p].mid  = bounds[2 * p + 1];
+	 merges[p].hi   = bounds[2 * p + 2];
+	 dict_thread_create( &merges[p].thread, dict_build_merge, &merges[p] );
+      }
+      if (runs % 2)
+	 memcpy( dest + bounds[runs - 1], src + bounds[runs - 1],
+		 (count - bounds[runs - 1]) * sizeof( dictIndexEntry ) );
+      for (p = 0; p < pairs; p++)
+	 dict_thread_join( merges[p].thread );
+
+      runs = (runs + 1) / 2;
+      for (p = 0; p < runs; p++)
+	 bounds[p] = bounds[2 * p];
+      bounds[runs] = count;
+      tmp  = src;
+      src  = dest;
+      dest = tmp;
+   }
+
+   xfree( merges );
+   xfree( bounds );
+   xfree( dest );
+   return src;
+}
+
+int dict_index_build(
+   const char *filename, const char *indexFilename, int threads )
+{
+   dictData       *data;
+   dictBuildScan  *scans;
+   dictIndexEntry *entries;
+   dictIndexEntry *sorted;
+   dictIndex      index;
+   unsigned long  length, unit, segment, piece, count, i, s;
+   int            segments;
+   char           *binFilename;
+   FILE           *str;
+   int            ret;
+
+   data = dict_data_open( filename, 0 );
+   if (data->type != DICT_TEXT && data->type != DICT_DZIP)
+      err_fatal( __func__,
+		 "Cannot index %s: only plain text and dictzip files"
+		 " can be read at random\n", filename );
+   length = data->length;
+   unit   = data->type == DICT_DZIP ? (unsigned long) data->chunkLength : 1;
+   dict_data_close( data );
+
+   if (threads <= 0)
+      threads = dict_cpu_count();
+   segment = (length / unit + threads) / threads * unit;
+   if (segment < DICT_BUILD_SEGMENT)
+      segment = (DICT_BUILD_SEGMENT + unit - 1) / unit * unit;
+   segments = (int) ((length + segment - 1) / segment);
+   if (!segments)
+      segments = 1;
+   piece = DICT_BUILD_PIECE > unit ? DICT_BUILD_PIECE / unit * unit : unit;
+
+   PRINTF(DBG_VERBOSE,("%s: %lu bytes, %d segments of %lu\n",
+		       __func__, length, segments, segment));
+
+   scans = xmalloc( segments * sizeof( dictBuildScan ) );
+   memset( scans, 0, segments * sizeof( dictBuildScan ) );
+   for (s = 0; s < (unsigned long) segments; s++) {
+      scans[s].filename = filename;
+      scans[s].from     = s * segment;
+      scans[s].to       = length - s * segment > segment
+			     ? (s + 1) * segment : length;
+      scans[s].piece    = piece;
+      dict_thread_create( &scans[s].thread, dict_build_scan, &scans[s] );
+   }
+   for (count = s = 0; s < (unsigned long) segments; s++) {
+      dict_thread_join( scans[s].thread );
+      count += scans[s].count;
+   }
+
+				/* Segments are in input order, so the
+                                   entries are too, and each ends where
+                                   the next starts. */
+   entries = xmalloc( (count + 1) * sizeof( dictIndexEntry ) );
+   for (count = s = 0; s < (unsigned long) segments; s++) {
+      if (scans[s].count)
+	 memcpy( entries + count, scans[s].entries,
+		 scans[s].count * sizeof( dictIndexEntry ) );
+      count += scans[s].count;
+      if (scans[s].entries)
+	 xfree( scans[s].entries );
+   }
+   xfree( scans );
+
+   memset( &index, 0, sizeof( index ) );
+   index.fd        = -1;
+   index.headwords = count;
+   for (i = 0; i < count; i++) {
+      entries[i].order = i;
+      entries[i].size  = (i + 1 < count ? entries[i + 1].start : length)
+			 - entries[i].start;
+      dict_index_check_flag( &index, entries[i].word,
+			     (int) strlen( entries[i].word ) );
+   }
+   dict_index_set_flags( &index );
+
+   sorted = dict_build_order( &index, entries, count, threads );
+
+   if (!(str = fopen( indexFilename, "wb" )))
+      err_fatal_errno( __func__,
+		       "Cannot open %s for write\n", indexFilename );
+   for (i = 0; i < count; i++) {
+      fprintf( str, "%s\t%s\t", sorted[i].word, b64_encode( sorted[i].start ) );
+      fprintf( str, "%s\n", b64_encode( sorted[i].size ) );
+   }
+   if (ferror( str ) || fclose( str ))
+      err_fatal_errno( __func__, "Cannot write %s\n", indexFilename );
+
+   binFilename = xmalloc( strlen( indexFilename ) + sizeof( DICT_BIN_SUFFIX ) );
+   strcpy( binFilename, indexFilename );
+   strcat( binFilename, DICT_BIN_SUFFIX );
+   ret = dict_bin_write( binFilename, indexFilename, &index, sorted, count );
+
+   PRINTF(DBG_VERBOSE,("%s: %lu headwords\n", __func__, count));
+
+   for (i = 0; i < count; i++) {
+      xfree( (char *) sorted[i].word );
+      xfree( (char *) sorted[i].key );
+   }
+   xfree( sorted );
+   xfree( binFilename );
+   return ret;
+}
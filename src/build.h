@@ -0,0 +1,34 @@
+/* build.h -- Build dictd indexes from dictionary text
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _BUILD_H_
+#define _BUILD_H_
+
+/* The input is dictionary text laid out the way dictfmt -f expects it:
+   a line that starts in column 0 begins an entry and holds its headword,
+   up to the first tab; indented and empty lines continue the entry.  An
+   entry runs until the next one starts, so its definition includes the
+   headword line. */
+
+/* Index the plain text or dictzip file |filename|: write the dictd
+   .index |indexFilename| and its compiled sidecar.  The input is
+   scanned, and for dictzip files inflated, by |threads| threads, or one
+   per CPU if |threads| is 0.  Returns 0 on success. */
+extern int dict_index_build (
+   const char *filename, const char *indexFilename, int threads );
+
+#endif /* _BUILD_H_ */
@@ -24,6 +24,8 @@
 
 #include "data.h"
 #include "dictzip.h"
+#include "filter.h"
+#include "transform.h"
 
 #include <sys/stat.h>
 #ifdef HAVE_MMAP
@@ -37,26 +39,98 @@
 #endif
 
 #include <sys/stat.h>
+#if defined(__linux__) && !defined(HAVE_MMAP)
+#include <sys/mman.h>
+#endif
 
 #define USE_CACHE 1
 
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
 #ifdef HAVE_MMAP
 int mmap_mode = 1; /* dictd uses mmap() function (the default) */
 #else
 int mmap_mode = 0;
 #endif
 
-#ifndef DICTZIP_WIN32
+/* Without mmap, keep the data file open and pread() compressed chunks on
+   cache misses instead of reading the whole file into memory.  Resident
+   memory then follows the working set, not the dictionary size. */
+int pread_mode = 1;
+
+/* Access pattern applied by dict_data_open(), see DICT_ADVICE_* */
+int advice_mode = DICT_ADVICE_RANDOM;
+
+/* Back the chunk cache with huge pages where the system grants them */
+int hugepage_mode = 0;
+
+/* Read exactly |len| bytes at |offset|.  Every read names its offset, so
+   concurrent readers (and the readahead thread) can share |fd| whatever
+   its file pointer is; on Win32, ReadFile() still moves the pointer of a
+   synchronous handle, but nothing relies on it.  Offsets are unsigned
+   long, 32 bits on Win32, so OffsetHigh is always 0 and files there are
+   limited to 4GB. */
+static void dict_pread(
+   const dictData *h, char *buffer, unsigned long len, unsigned long offset )
+{
+#ifdef _WIN32
+   HANDLE     file = (HANDLE) _get_osfhandle( h->fd );
+   OVERLAPPED ov;
+   DWORD      count;
+
+   while (len) {
+      memset( &ov, 0, sizeof( ov ) );
+      ov.Offset     = offset;
+      ov.OffsetHigh = 0;
+      if (!ReadFile( file, buffer, len, &count, &ov ) || !count)
+	 err_fatal( __func__, "Cannot read data file \"%s\" (%lu)\n",
+		    h->filename, (unsigned long) GetLastError() );
+      buffer += count;
+      offset += count;
+      len    -= count;
+   }
+#else
+   ssize_t count;
+
+   while (len) {
+      if ((count = pread( h->fd, buffer, len, offset )) <= 0) {
+	 if (count < 0 && errno == EINTR)
+	    continue;
+	 err_fatal_errno( __func__,
+			  "Cannot read data file \"%s\"\n", h->filename );
+      }
+      buffer += count;
+      offset += count;
+      len    -= count;
+   }
+#endif
+}
+
+
 int dict_data_filter( char *buffer, int *len, int maxLength,
 		      const char *filter )
 {
-   char *outBuffer;
-   int  outLen;
+   char               *outBuffer;
+   int                outLen;
+   dictFilterFunction fn;
+   void               *state;
 
    if (!filter) return 0;
    outBuffer = xmalloc( maxLength + 2 );
    
-   outLen = pr_filter( filter, buffer, *len, outBuffer, maxLength + 1 );
+   if (dict_filter_find( filter, &fn, &state ))
+      outLen = fn( state, buffer, *len, outBuffer, maxLength + 1 );
+   else {
+#ifdef DICTZIP_WIN32
+      err_fatal( __func__, "No filter named \"%s\"\n", filter );
+#else
+      outLen = pr_filter( filter, buffer, *len, outBuffer, maxLength + 1 );
+#endif
+   }
+   if (outLen < 0)
+      err_fatal( __func__, "Filter \"%s\" failed\n", filter );
    if (outLen > maxLength )
       err_fatal( __func__,
 		 "Filter grew buffer from %d past limit of %d\n",
@@ -70,7 +144,6 @@ int dict_data_filter( char *buffer, int *len, int maxLength,
    
    return 0;
 }
-#endif
 
 static int dict_read_header( const char *filename,
 			     dictData *header, int computeCRC )
@@ -140,7 +213,7 @@ static int dict_read_header( const char *filename,
 	 header->version      = getc( str ) << 0;
 	 header->version     |= getc( str ) << 8;
 	 
-	 if (header->version != 1)
+	 if (header->version != 1 && header->version != 2)
 	    err_internal( __func__,
 			  "dzip header version %d not supported\n",
 			  header->version );
@@ -159,6 +232,15 @@ static int dict_read_header( const char *filename,
 	 for (i = 0; i < header->chunkCount; i++) {
 	    header->chunks[i]  = getc( str ) << 0;
 	    header->chunks[i] |= getc( str ) << 8;
+	 }
+				/* version 2 names the transform */
+	 if (header->version == 2) {
+	    header->transform  = getc( str ) << 0;
+	    header->transform |= getc( str ) << 8;
+	    if (header->transform != DICT_TRANSFORM_TOKENS)
+	       err_fatal( __func__,
+			  "dzip transform %d of \"%s\" not supported\n",
+			  header->transform, filename );
 	 }
 	 header->type = DICT_DZIP;
       } else {
@@ -179,7 +261,7 @@ static int dict_read_header( const char *filename,
       }
 
       *pt = '\0';
-      header->origFilename = buffer; // str_find( buffer );
+      header->origFilename = strcpy( xmalloc( pt - buffer + 1 ), buffer );
       header->headerLength += strlen( header->origFilename ) + 1;
    } else {
       header->origFilename = NULL;
@@ -219,7 +301,7 @@ static int dict_read_header( const char *filename,
    header->crc     = getc( str ) <<  0;
    header->crc    |= getc( str ) <<  8;
    header->crc    |= getc( str ) << 16;
-   header->crc    |= getc( str ) << 24;
+   header->crc    |= (unsigned long) getc( str ) << 24;
    header->length  = getc( str ) <<  0;
    header->length |= getc( str ) <<  8;
    header->length |= getc( str ) << 16;
@@ -241,37 +323,154 @@ static int dict_read_header( const char *filename,
    return 0;
 }
 
-dictData *dict_data_open( const char *filename, int computeCRC )
+static int dict_advice_open_flags( int advice )
 {
-   dictData    *h = NULL;
-   struct stat sb;
-   int         j;
+#if defined(_O_RANDOM) && defined(_O_SEQUENTIAL)
+   switch (advice) {
+   case DICT_ADVICE_RANDOM:     return _O_RANDOM;
+   case DICT_ADVICE_SEQUENTIAL: return _O_SEQUENTIAL;
+   }
+#endif
+   return 0;
+}
 
-   if (!filename)
-      return NULL;
+/* Apply |advice| to the mapping or, in pread mode, to the descriptor.
+   Windows only takes hints when the file is opened, so there the
+   advice_mode in effect at dict_data_open() time is what counts. */
+void dict_data_advise( dictData *h, int advice )
+{
+   if (!h)
+      return;
 
-   h = xmalloc( sizeof( struct dictData ) );
+   h->advice = advice;
+#ifdef HAVE_MMAP
+   if (mmap_mode && h->start) {
+      madvise( (void *)h->start, h->size,
+	       advice == DICT_ADVICE_RANDOM     ? MADV_RANDOM :
+	       advice == DICT_ADVICE_SEQUENTIAL ? MADV_SEQUENTIAL :
+	       MADV_NORMAL );
+      return;
+   }
+#endif
+#ifdef POSIX_FADV_RANDOM
+   if (!h->start && h->fd >= 0) {
+      posix_fadvise( h->fd, 0, 0,
+		     advice == DICT_ADVICE_RANDOM     ? POSIX_FADV_RANDOM :
+		     advice == DICT_ADVICE_SEQUENTIAL ? POSIX_FADV_SEQUENTIAL :
+		     POSIX_FADV_NORMAL );
+   }
+#endif
+}
 
-   memset( h, 0, sizeof( struct dictData ) );
-   h->initialized = 0;
+#define DICT_CACHE_BUFFERS (DICT_CACHE_SIZE + 1) /* cache plus spare */
 
-   if (stat( filename, &sb ) || !S_ISREG(sb.st_mode)) {
-      err_warning( __func__,
-		   "%s is not a regular file -- ignoring\n", filename );
-      return h;
+/* Allocate one region holding every chunk buffer of a handle, backed by
+   huge pages if possible.  Huge pages are 2MB or more, so this trades
+   memory for fewer page faults and TLB misses on hot dictionaries. */
+static char *dict_cache_region_alloc( unsigned long *size )
+{
+   char          *region;
+   unsigned long len = DICT_CACHE_BUFFERS * IN_BUFFER_SIZE;
+#ifdef _WIN32
+   typedef SIZE_T (WINAPI *largePageMinimumFunction)( void );
+   largePageMinimumFunction largePageMinimum;
+   SIZE_T                   large = 0;
+
+				/* Not available on XP. */
+   largePageMinimum = (largePageMinimumFunction) GetProcAddress(
+      GetModuleHandle( TEXT( "kernel32.dll" ) ), "GetLargePageMinimum" );
+   if (largePageMinimum)
+      large = largePageMinimum();
+   if (large) {
+      *size  = (len + large - 1) / large * large;
+				/* Needs SeLockMemoryPrivilege. */
+      region = VirtualAlloc( NULL, *size,
+			     MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+			     PAGE_READWRITE );
+      if (region)
+	 return region;
    }
-   
-   if (dict_read_header( filename, h, computeCRC )) {
-      err_fatal( __func__,
-		 "\"%s\" not in text or dzip format\n", filename );
+   *size  = len;
+   region = VirtualAlloc( NULL, *size, MEM_RESERVE | MEM_COMMIT,
+			  PAGE_READWRITE );
+   if (!region)
+      err_fatal( __func__, "VirtualAlloc failed (%lu)\n",
+		 (unsigned long) GetLastError() );
+   return region;
+#elif defined(__linux__)
+   unsigned long huge = 2UL * 1024 * 1024;
+
+   *size  = (len + huge - 1) / huge * huge;
+#ifdef MAP_HUGETLB
+   region = mmap( NULL, *size, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+   if (region != MAP_FAILED)
+      return region;
+#endif
+				/* Fall back to transparent huge pages. */
+   region = mmap( NULL, *size, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+   if (region == MAP_FAILED)
+      err_fatal_errno( __func__, "Cannot map chunk cache\n" );
+#ifdef MADV_HUGEPAGE
+   madvise( region, *size, MADV_HUGEPAGE );
+#endif
+   return region;
+#else
+   *size = len;
+   return xmalloc( len );
+#endif
+}
+
+static void dict_cache_region_free( char *region, unsigned long size )
+{
+#ifdef _WIN32
+   VirtualFree( region, 0, MEM_RELEASE );
+#elif defined(__linux__)
+   munmap( region, size );
+#else
+   xfree( region );
+#endif
+}
+
+/* Make sure |*slot| points to a chunk buffer.  With hugepage_mode all
+   buffers come from one region on first use; they are swapped between
+   cache slots and the readahead spare but never freed one by one. */
+static char *dict_cache_buffer( dictData *h, char **slot )
+{
+   int j;
+
+   if (!*slot && hugepage_mode && !h->cacheRegion && !h->readahead.spare) {
+      for (j = 0; j < DICT_CACHE_SIZE; j++) {
+	 if (h->cache[j].inBuffer)
+	    break;
+      }
+      if (j == DICT_CACHE_SIZE) {
+	 h->cacheRegion = dict_cache_region_alloc( &h->cacheRegionSize );
+	 for (j = 0; j < DICT_CACHE_SIZE; j++)
+	    h->cache[j].inBuffer = h->cacheRegion + j * IN_BUFFER_SIZE;
+	 h->readahead.spare =
+	    h->cacheRegion + DICT_CACHE_SIZE * IN_BUFFER_SIZE;
+      }
    }
-   
-   if ((h->fd = open( filename, O_RDONLY )) < 0)
+   if (!*slot)
+      *slot = xmalloc( IN_BUFFER_SIZE );
+   return *slot;
+}
+
+/* Open the data file and map it, or load it, according to mmap_mode and
+   pread_mode. */
+static void dict_data_map( dictData *h )
+{
+   struct stat sb;
+
+   if ((h->fd = open( h->filename, O_RDONLY | O_BINARY
+		      | dict_advice_open_flags( h->advice ) )) < 0)
       err_fatal_errno( __func__,
-		       "Cannot open data file \"%s\"\n", filename );
+		       "Cannot open data file \"%s\"\n", h->filename );
    if (fstat( h->fd, &sb ))
       err_fatal_errno( __func__,
-		       "Cannot stat data file \"%s\"\n", filename );
+		       "Cannot stat data file \"%s\"\n", h->filename );
    h->size = sb.st_size;
 
    if (mmap_mode){
@@ -280,22 +479,227 @@ dictData *dict_data_open( const char *filename, int computeCRC )
       if ((void *)h->start == (void *)(-1))
 	 err_fatal_errno(
 	    __func__,
-	    "Cannot mmap data file \"%s\"\n", filename );
+	    "Cannot mmap data file \"%s\"\n", h->filename );
 #else
       err_fatal (__func__, "This should not happen");
 #endif
+   }else if (pread_mode){
+      h->start = NULL;
    }else{
       h->start = xmalloc (h->size);
       if (-1 == read (h->fd, (char *) h->start, h->size))
 	 err_fatal_errno (
 	    __func__,
-	    "Cannot read data file \"%s\"\n", filename );
+	    "Cannot read data file \"%s\"\n", h->filename );
 
       close (h -> fd);
-      h -> fd = 0;
+      h -> fd = -1;
+   }
+
+   if (h->start)
+      h->end = h->start + h->size;
+   h->mapped = 1;
+
+   dict_data_advise( h, h->advice );
+}
+
+static void dict_data_unmap( dictData *h )
+{
+   if (!h->mapped)
+      return;
+
+   if (mmap_mode){
+#ifdef HAVE_MMAP
+      munmap( (void *)h->start, h->size );
+#else
+      err_fatal (__func__, "This should not happen");
+#endif
+   }else if (h->start){
+      xfree ((char *) h->start);
    }
+   if (h->fd >= 0)
+      close (h->fd);
 
-   h->end = h->start + h->size;
+   h->fd     = -1;
+   h->start  = h->end = NULL;
+   h->mapped = 0;
+}
+
+/* Handle manager.  When data_open_max or data_mapped_max is set, data
+   files are opened (and mapped or loaded) on first read only, and the
+   least recently used idle ones are closed again whenever a cap would be
+   exceeded.  The caps are soft: handles in use are never closed. */
+int           data_open_max   = 0; /* open data files, 0 for no limit    */
+unsigned long data_mapped_max = 0; /* bytes mapped or loaded, 0 for none */
+
+static dictOnce      dataLruOnce = DICT_ONCE_INIT;
+static dictMutex     dataLruLock;
+static dictData      *dataLruHead;	/* most recently used */
+static dictData      *dataLruTail;	/* least recently used */
+static int           dataLruOpen;
+static unsigned long dataLruBytes;
+
+static void dict_data_lru_init( void )
+{
+   dict_mutex_init( &dataLruLock );
+}
+
+static unsigned long dict_data_resident( const dictData *h )
+{
+   return h->start ? h->size : 0;
+}
+
+static void dict_data_lru_unlink( dictData *h )
+{
+   if (h->lruPrev) h->lruPrev->lruNext = h->lruNext;
+   else            dataLruHead         = h->lruNext;
+   if (h->lruNext) h->lruNext->lruPrev = h->lruPrev;
+   else            dataLruTail         = h->lruPrev;
+   h->lruPrev = h->lruNext = NULL;
+}
+
+static void dict_data_lru_push( dictData *h )
+{
+   h->lruPrev = NULL;
+   h->lruNext = dataLruHead;
+   if (dataLruHead) dataLruHead->lruPrev = h;
+   else             dataLruTail          = h;
+   dataLruHead = h;
+}
+
+/* Close idle handles, oldest first, until |h| fits.  Called with
+   dataLruLock held. */
+static void dict_data_lru_evict( dictData *h )
+{
+   dictData      *victim, *prev;
+   unsigned long need = mmap_mode || !pread_mode ? h->size : 0;
+
+   for (victim = dataLruTail; victim; victim = prev) {
+      prev = victim->lruPrev;
+      if (!(data_open_max && dataLruOpen >= data_open_max)
+	  && !(data_mapped_max && dataLruBytes + need > data_mapped_max))
+	 break;
+      if (victim->users)
+	 continue;
+
+      PRINTF(DBG_UNZIP,("closing idle data file %s\n", victim->filename));
+      dataLruBytes -= dict_data_resident( victim );
+      --dataLruOpen;
+      dict_data_lru_unlink( victim );
+      dict_data_unmap( victim );
+   }
+}
+
+/* Make sure the data file behind |h| is open and keep it open until the
+   matching dict_data_detach().  The file is opened and mapped without
+   dataLruLock, so that opening one dictionary does not hold up reads of
+   the others; its share of the caps is reserved first, and other readers
+   of |h| wait until it is open. */
+static void dict_data_attach( dictData *h )
+{
+   unsigned long reserved;
+
+   if (!h->managed)
+      return;
+
+   dict_mutex_lock( &dataLruLock );
+   ++h->users;			/* also keeps |h| from being evicted */
+   while (h->mapping) {
+      ++h->mapWaiters;
+      dict_mutex_unlock( &dataLruLock );
+      dict_semaphore_wait( &h->mapDone );
+      dict_mutex_lock( &dataLruLock );
+   }
+   if (h->mapped) {
+      dict_data_lru_unlink( h );
+      dict_data_lru_push( h );
+      dict_mutex_unlock( &dataLruLock );
+      return;
+   }
+
+   dict_data_lru_evict( h );
+   reserved      = mmap_mode || !pread_mode ? h->size : 0;
+   dataLruBytes += reserved;
+   ++dataLruOpen;
+   h->mapping = 1;
+   dict_mutex_unlock( &dataLruLock );
+
+   dict_data_map( h );
+
+   dict_mutex_lock( &dataLruLock );
+   dataLruBytes += dict_data_resident( h ); /* the size may have changed */
+   dataLruBytes -= reserved;
+   dict_data_lru_push( h );
+   h->mapping = 0;
+   while (h->mapWaiters) {
+      --h->mapWaiters;
+      dict_semaphore_post( &h->mapDone );
+   }
+   dict_mutex_unlock( &dataLruLock );
+}
+
+static void dict_data_detach( dictData *h )
+{
+   if (!h->managed)
+      return;
+
+   dict_mutex_lock( &dataLruLock );
+   --h->users;
+   dict_mutex_unlock( &dataLruLock );
+}
+
+/* Copy |len| bytes of the data file starting at |offset| into |buffer|. */
+static void dict_data_fetch(
+   dictData *h, char *buffer, unsigned long len, unsigned long offset )
+{
+   dict_data_attach( h );
+   if (h->start)
+      memcpy( buffer, h->start + offset, len );
+   else
+      dict_pread( h, buffer, len, offset );
+   dict_data_detach( h );
+}
+
+dictData *dict_data_open( const char *filename, int computeCRC )
+{
+   dictData    *h = NULL;
+   struct stat sb;
+   int         j;
+
+   if (!filename)
+      return NULL;
+
+   h = xmalloc( sizeof( struct dictData ) );
+
+   memset( h, 0, sizeof( struct dictData ) );
+   h->fd          = -1;
+
+   dict_mutex_init( &h->lock );
+   h->readahead.lastChunk = -2;
+   h->readahead.inflight  = -1;
+   dict_semaphore_init( &h->readahead.wake, 0 );
+   dict_semaphore_init( &h->readahead.done, 0 );
+   dict_semaphore_init( &h->mapDone, 0 );
+
+   if (stat( filename, &sb ) || !S_ISREG(sb.st_mode)) {
+      err_warning( __func__,
+		   "%s is not a regular file -- ignoring\n", filename );
+      return h;
+   }
+   
+   if (dict_read_header( filename, h, computeCRC )) {
+      err_fatal( __func__,
+		 "\"%s\" not in text or dzip format\n", filename );
+   }
+   
+   h->advice = advice_mode;
+   h->size   = sb.st_size;
+   if (data_open_max || data_mapped_max) {
+      dict_once( &dataLruOnce, dict_data_lru_init );
+      h->managed = 1;		/* opened by dict_data_attach() */
+   } else {
+      dict_data_map( h );
+   }
 
    for (j = 0; j < DICT_CACHE_SIZE; j++) {
       h->cache[j].chunk    = -1;
@@ -314,39 +718,462 @@ void dict_data_close( dictData *header )
    if (!header)
       return;
 
-   if (header->fd >= 0) {
-      if (mmap_mode){
-#ifdef HAVE_MMAP
-	 munmap( (void *)header->start, header->size );
-	 close( header->fd );
-	 header->fd = 0;
-	 header->start = header->end = NULL;
-#else
-	 err_fatal (__func__, "This should not happen");
-#endif
-      }else{
-	 if (header -> start)
-	    xfree ((char *) header -> start);
+   if (header->readahead.running) {
+      dict_mutex_lock( &header->lock );
+      header->readahead.stop = 1;
+      dict_mutex_unlock( &header->lock );
+      dict_semaphore_post( &header->readahead.wake );
+      dict_thread_join( header->readahead.thread );
+   }
+   if (header->readahead.spare && !header->cacheRegion)
+      xfree( header->readahead.spare );
+   dict_semaphore_destroy( &header->readahead.wake );
+   dict_semaphore_destroy( &header->readahead.done );
+   dict_semaphore_destroy( &header->mapDone );
+   dict_mutex_destroy( &header->lock );
+
+   if (header->managed) {
+      dict_mutex_lock( &dataLruLock );
+      if (header->mapped) {
+	 dataLruBytes -= dict_data_resident( header );
+	 --dataLruOpen;
+	 dict_data_lru_unlink( header );
       }
+      dict_data_unmap( header );
+      dict_mutex_unlock( &dataLruLock );
+   } else {
+      dict_data_unmap( header );
    }
 
+   if (header->origFilename && header->origFilename != header->filename)
+      xfree( (char *) header->origFilename );
    if (header->chunks)       xfree( header->chunks );
    if (header->offsets)      xfree( header->offsets );
 
-   if (header->initialized) {
-      if (inflateEnd( &header->zStream ))
+   if (header->cacheRegion) {
+      dict_cache_region_free( header->cacheRegion, header->cacheRegionSize );
+   } else {
+      for (i = 0; i < DICT_CACHE_SIZE; ++i){
+	 if (header -> cache [i].inBuffer)
+	    xfree (header -> cache [i].inBuffer);
+      }
+   }
+
+   memset( header, 0, sizeof( struct dictData ) );
+   xfree( header );
+}
+
+/* Inflate streams are not tied to a handle.  Each chunk was deflated
+   after a full flush, so any stream can inflate any chunk once it has been
+   reset; streams are leased per chunk from this pool.  Memory thus grows
+   with the number of concurrent inflates, not with the number of open
+   dictionaries.  At most inflate_pool_max idle streams are kept. */
+int inflate_pool_max = 16;
+
+typedef struct dictInflater {
+   z_stream            zStream;	/* must be first */
+   struct dictInflater *next;
+} dictInflater;
+
+static dictOnce     inflatePoolOnce = DICT_ONCE_INIT;
+static dictMutex    inflatePoolLock;
+static dictInflater *inflatePool;
+static int          inflatePoolIdle;
+
+static void dict_inflate_pool_init( void )
+{
+   dict_mutex_init( &inflatePoolLock );
+}
+
+static z_stream *dict_inflate_lease( void )
+{
+   dictInflater *inflater;
+
+   dict_once( &inflatePoolOnce, dict_inflate_pool_init );
+
+   dict_mutex_lock( &inflatePoolLock );
+   if ((inflater = inflatePool)) {
+      inflatePool = inflater->next;
+      --inflatePoolIdle;
+   }
+   dict_mutex_unlock( &inflatePoolLock );
+
+   if (!inflater) {
+      inflater = xmalloc( sizeof( dictInflater ) );
+      memset( inflater, 0, sizeof( dictInflater ) );
+      if (inflateInit2( &inflater->zStream, -15 ) != Z_OK)
 	 err_internal( __func__,
-		       "Cannot shut down inflation engine: %s\n",
-		       header->zStream.msg );
+		       "Cannot initialize inflation engine: %s\n",
+		       inflater->zStream.msg );
    }
+   return &inflater->zStream;
+}
 
-   for (i = 0; i < DICT_CACHE_SIZE; ++i){
-      if (header -> cache [i].inBuffer)
-	 xfree (header -> cache [i].inBuffer);
+static void dict_inflate_release( z_stream *zStream )
+{
+   dictInflater *inflater = (dictInflater *) zStream;
+
+   if (inflateReset( zStream ) == Z_OK) {
+      dict_mutex_lock( &inflatePoolLock );
+      if (inflatePoolIdle < inflate_pool_max) {
+	 inflater->next = inflatePool;
+	 inflatePool    = inflater;
+	 ++inflatePoolIdle;
+	 inflater       = NULL;
+      }
+      dict_mutex_unlock( &inflatePoolLock );
    }
 
-   memset( header, 0, sizeof( struct dictData ) );
-   xfree( header );
+   if (inflater) {
+      inflateEnd( zStream );
+      xfree( inflater );
+   }
+}
+
+/* Inflate chunk |chunk| into |inBuffer| (IN_BUFFER_SIZE bytes) and return
+   the number of bytes produced, or -1 with the reason in |error|
+   (BUFFERSIZE bytes) if the chunk is corrupt.  Only reads immutable parts
+   of |h| (and pread()s the file), so the readahead thread may call it
+   without holding |h->lock|. */
+static int dict_data_inflate_chunk(
+   dictData *h, int chunk, char *inBuffer,
+   const char *preFilter, const char *postFilter, char *error )
+{
+   char     outBuffer[OUT_BUFFER_SIZE];
+   char     coded[IN_BUFFER_SIZE];	/* inflated, still transformed */
+   char     *target = h->transform ? coded : inBuffer;
+   int      count, expected, status, pending;
+   z_stream *zStream;
+
+   if (h->chunks[chunk] >= OUT_BUFFER_SIZE ) {
+      snprintf( error, BUFFERSIZE,
+		"h->chunks[%d] = %d >= %ld (OUT_BUFFER_SIZE)",
+		chunk, h->chunks[chunk], (long) OUT_BUFFER_SIZE );
+      return -1;
+   }
+   dict_data_fetch( h, outBuffer, h->chunks[chunk], h->offsets[chunk] );
+   count = h->chunks[chunk];
+   dict_data_filter( outBuffer, &count, OUT_BUFFER_SIZE, preFilter );
+
+   zStream = dict_inflate_lease();
+   zStream->next_in   = (Bytef *) outBuffer;
+   zStream->avail_in  = count;
+   zStream->next_out  = (Bytef *) target;
+   zStream->avail_out = IN_BUFFER_SIZE;
+   status  = inflate( zStream,  Z_PARTIAL_FLUSH );
+   pending = zStream->avail_in;
+   if (status != Z_OK)
+      snprintf( error, BUFFERSIZE, "inflate: %s in chunk %d",
+		zStream->msg ? zStream->msg : "error", chunk );
+   else if (pending)
+      snprintf( error, BUFFERSIZE,
+		"inflate did not flush chunk %d (%d pending, %d avail)",
+		chunk, pending, (int) zStream->avail_out );
+   count = IN_BUFFER_SIZE - zStream->avail_out;
+   dict_inflate_release( zStream );
+   if (status != Z_OK || pending)
+      return -1;
+
+				/* a chunk of full length was stored as
+                                   it is */
+   if (h->transform) {
+      expected = chunk < h->chunkCount - 1
+		 ? h->chunkLength
+		 : (int) (h->length - (unsigned long) chunk * h->chunkLength);
+      if (count == expected)
+	 memcpy( inBuffer, coded, count );
+      else if (dict_transform_decode( h->transform, coded, count,
+				      inBuffer, expected )) {
+	 snprintf( error, BUFFERSIZE, "Cannot decode chunk %d", chunk );
+	 return -1;
+      }
+      count = expected;
+   }
+   dict_data_filter( inBuffer, &count, IN_BUFFER_SIZE, postFilter );
+
+   return count;
+}
+
+/* dict_data_inflate_chunk() for reads, where a corrupt chunk is fatal */
+static int dict_data_inflate(
+   dictData *h, int chunk, char *inBuffer,
+   const char *preFilter, const char *postFilter )
+{
+   char error[BUFFERSIZE];
+   int  count;
+
+   if ((count = dict_data_inflate_chunk( h, chunk, inBuffer,
+					 preFilter, postFilter, error )) < 0)
+      err_fatal( __func__, "%s of \"%s\"\n", error, h->filename );
+   return count;
+}
+
+static int dict_cache_lookup( const dictData *h, int chunk )
+{
+#if USE_CACHE
+   int j;
+
+   for (j = 0; j < DICT_CACHE_SIZE; j++) {
+      if (h->cache[j].chunk == chunk)
+	 return j;
+   }
+#endif
+   return -1;
+}
+
+/* The least recently used slot.  While readahead is active, chunks it
+   has inflated that the reader has not reached yet are spared: their
+   install stamps are older than those of the chunks just read, but they
+   are needed sooner.  The window leaves room for them and the chunk
+   being read, so a slot outside it normally exists. */
+static int dict_cache_victim( const dictData *h )
+{
+   const dictReadahead *ra = &h->readahead;
+   int                 j, chunk;
+   int                 target    = -1;
+   int                 lastStamp = INT_MAX;
+   int                 spare     = ra->window
+				   && ra->sequential >= DICT_READAHEAD_TRIGGER;
+
+   for (j = 0; j < DICT_CACHE_SIZE; j++) {
+      chunk = h->cache[j].chunk;
+      if (spare && chunk > ra->lastChunk && chunk <= ra->last)
+	 continue;
+      if (h->cache[j].stamp < lastStamp) {
+	 lastStamp = h->cache[j].stamp;
+	 target = j;
+      }
+   }
+   if (target >= 0)
+      return target;
+
+   for (target = j = 0; j < DICT_CACHE_SIZE; j++) {
+      if (h->cache[j].stamp < h->cache[target].stamp)
+	 target = j;
+   }
+   return target;
+}
+
+static void dict_readahead_thread( void *arg )
+{
+   dictData      *h  = arg;
+   dictReadahead *ra = &h->readahead;
+   dictCache     *c;
+   char          *buffer;
+   const char    *preFilter, *postFilter;
+   int           chunk;
+   int           count;
+   double        started, elapsed;
+   char          error[BUFFERSIZE];
+
+   dict_mutex_lock( &h->lock );
+   for (;;) {
+      while (!ra->stop && ra->next > ra->last) {
+	 dict_mutex_unlock( &h->lock );
+	 dict_semaphore_wait( &ra->wake );
+	 dict_mutex_lock( &h->lock );
+      }
+      if (ra->stop)
+	 break;
+
+      chunk = ra->next++;
+      if (dict_cache_lookup( h, chunk ) >= 0)
+	 continue;
+
+      ra->inflight = chunk;
+      buffer     = dict_cache_buffer( h, &ra->spare );
+      preFilter  = ra->preFilter;
+      postFilter = ra->postFilter;
+      dict_mutex_unlock( &h->lock );
+
+				/* a corrupt chunk is left for the
+                                   reader to inflate and report */
+      started = dict_seconds();
+      count   = dict_data_inflate_chunk( h, chunk, buffer,
+					 preFilter, postFilter, error );
+      elapsed = dict_seconds() - started;
+
+      dict_mutex_lock( &h->lock );
+      if (count < 0) {
+	 ra->inflight = -1;
+	 ra->next     = ra->last + 1;
+	 while (ra->waiters) {
+	    --ra->waiters;
+	    dict_semaphore_post( &ra->done );
+	 }
+	 continue;
+      }
+      c           = &h->cache[dict_cache_victim( h )];
+      if (c->chunk >= 0)
+	 ++h->stats.evictions;
+      ++h->stats.prefetches;
+      h->stats.inflatedBytes  += count;
+      h->stats.inflateSeconds += elapsed;
+      ra->spare   = c->inBuffer;
+      c->inBuffer = buffer;
+      c->chunk    = chunk;
+      c->count    = count;
+      c->stamp    = ++h->stamp;
+
+      ra->inflight = -1;
+      while (ra->waiters) {
+	 --ra->waiters;
+	 dict_semaphore_post( &ra->done );
+      }
+   }
+   dict_mutex_unlock( &h->lock );
+}
+
+/* Called with |h->lock| held after |chunk| has been consumed.  Once
+   DICT_READAHEAD_TRIGGER consecutive chunks have been read in order, the
+   next |window| chunks are handed to the background thread. */
+static void dict_readahead_note(
+   dictData *h, int chunk,
+   const char *preFilter, const char *postFilter )
+{
+   dictReadahead *ra = &h->readahead;
+
+   if (!ra->window)
+      return;
+
+   if (chunk == ra->lastChunk || chunk == ra->lastChunk + 1)
+      ++ra->sequential;
+   else
+      ra->sequential = 0;
+   ra->lastChunk = chunk;
+
+   if (ra->sequential < DICT_READAHEAD_TRIGGER)
+      return;
+
+   ra->next = chunk + 1;
+   ra->last = chunk + ra->window;
+   if (ra->last >= h->chunkCount)
+      ra->last = h->chunkCount - 1;
+   if (ra->next > ra->last)
+      return;
+
+   ra->preFilter  = preFilter;
+   ra->postFilter = postFilter;
+   if (!ra->running) {
+      ra->running = 1;
+      dict_thread_create( &ra->thread, dict_readahead_thread, h );
+   }
+   dict_semaphore_post( &ra->wake );
+}
+
+int dict_data_verify( dictData *h, char *error )
+{
+   char          *buffer;
+   unsigned long crc   = crc32( 0L, Z_NULL, 0 );
+   unsigned long total = 0;
+   double        started;
+   int           count, i;
+
+   if (h->type != DICT_DZIP)
+      return 0;
+
+   buffer  = xmalloc( IN_BUFFER_SIZE );
+   started = dict_seconds();
+   for (i = 0; i < h->chunkCount; i++) {
+      if ((count = dict_data_inflate_chunk( h, i, buffer,
+					    NULL, NULL, error )) < 0)
+	 break;
+      crc    = crc32( crc, (const Bytef *) buffer, count );
+      total += count;
+   }
+   xfree( buffer );
+				/* the chunks bypass the cache, and count
+                                   as misses */
+   dict_mutex_lock( &h->lock );
+   h->stats.misses         += i;
+   h->stats.inflatedBytes  += total;
+   h->stats.inflateSeconds += dict_seconds() - started;
+   dict_mutex_unlock( &h->lock );
+
+   if (i < h->chunkCount)
+      return -1;
+   if ((crc ^ h->crc) & 0xffffffffUL) {
+      snprintf( error, BUFFERSIZE, "data does not match its CRC" );
+      return -1;
+   }
+   if (total != h->length) {
+      snprintf( error, BUFFERSIZE, "data is %lu bytes instead of %lu",
+		total, h->length );
+      return -1;
+   }
+   return 0;
+}
+
+void dict_data_get_stats( dictData *h, dictDataStats *stats )
+{
+   dict_mutex_lock( &h->lock );
+   *stats = h->stats;
+   dict_mutex_unlock( &h->lock );
+}
+
+void dict_data_set_readahead( dictData *h, int chunks )
+{
+   if (!h || h->type != DICT_DZIP)
+      return;
+
+   if (chunks < 0)
+      chunks = 0;
+   if (chunks > DICT_READAHEAD_MAX)
+      chunks = DICT_READAHEAD_MAX;
+
+   dict_mutex_lock( &h->lock );
+   h->readahead.window = chunks;
+   dict_mutex_unlock( &h->lock );
+}
+
+/* Return the inflated contents of chunk |i|, from the cache if possible.
+   Called with |h->lock| held; the result stays valid until it is
+   released.  A corrupt chunk is fatal, or with |error| returns NULL and
+   the reason there. */
+static const char *dict_data_chunk(
+   dictData *h, int i, int *count,
+   const char *preFilter, const char *postFilter, char *error )
+{
+   dictReadahead *ra = &h->readahead;
+   dictCache     *c;
+   int           target;
+   double        started;
+
+   while (ra->inflight == i) {
+      ++ra->waiters;
+      dict_mutex_unlock( &h->lock );
+      dict_semaphore_wait( &ra->done );
+      dict_mutex_lock( &h->lock );
+   }
+
+   if ((target = dict_cache_lookup( h, i )) >= 0) {
+      c = &h->cache[target];
+      ++h->stats.hits;
+   } else {
+      c = &h->cache[dict_cache_victim( h )];
+      if (c->chunk >= 0)
+	 ++h->stats.evictions;
+      c->chunk = i;
+      dict_cache_buffer( h, &c->inBuffer );
+      started  = dict_seconds();
+      c->count = error
+		 ? dict_data_inflate_chunk( h, i, c->inBuffer,
+					    preFilter, postFilter, error )
+		 : dict_data_inflate( h, i, c->inBuffer,
+				      preFilter, postFilter );
+      if (c->count < 0) {
+	 c->chunk = -1;
+	 c->count = 0;
+	 return NULL;
+      }
+      ++h->stats.misses;
+      h->stats.inflatedBytes  += c->count;
+      h->stats.inflateSeconds += dict_seconds() - started;
+   }
+
+   c->stamp = ++h->stamp;
+   *count = c->count;
+   return c->inBuffer;
 }
 
 char *dict_data_obtain (const dictDatabase *db, const dictWord *dw)
@@ -380,20 +1207,65 @@ char *dict_data_obtain (const dictDatabase *db, const dictWord *dw)
    }
 }
 
+/* Count a read of |len| bytes of plain text.  Reads of dictzip files are
+   counted by dict_data_copy_chunk(), which holds the lock already. */
+static void dict_data_count_read( dictData *h, unsigned long len )
+{
+   dict_mutex_lock( &h->lock );
+   ++h->stats.reads;
+   h->stats.copiedBytes += len;
+   dict_mutex_unlock( &h->lock );
+}
+
+/* Copy the part of chunk |i| that lies in [|start|, |end|) of the
+   uncompressed text to |dest| and return its length.  A corrupt chunk
+   is fatal, or with |error| returns -1 and the reason there. */
+static long dict_data_copy_chunk(
+   dictData *h, int i, unsigned long start, unsigned long end, char *dest,
+   const char *preFilter, const char *postFilter, char *error )
+{
+   unsigned long base = (unsigned long) i * h->chunkLength;
+   unsigned long from = start > base ? start - base : 0;
+   unsigned long to   = end - base < (unsigned long) h->chunkLength
+			? end - base : (unsigned long) h->chunkLength;
+   const char    *inBuffer;
+   int           count;
+
+				/* Access cache; the lock is dropped
+                                   between chunks so that readahead can
+                                   install the ones that follow. */
+   dict_mutex_lock( &h->lock );
+   inBuffer = dict_data_chunk( h, i, &count, preFilter, postFilter, error );
+   if (inBuffer && (unsigned long) count < to) {
+      if (!error)
+	 err_internal( __func__,
+		       "Length = %d instead of at least %lu\n", count, to );
+      snprintf( error, BUFFERSIZE,
+		"chunk %d is %d bytes instead of at least %lu", i, count, to );
+      inBuffer = NULL;
+   }
+   if (!inBuffer) {
+      dict_mutex_unlock( &h->lock );
+      return -1;
+   }
+   memcpy( dest, inBuffer + from, to - from );
+   if (start >= base)		/* the first chunk of the read */
+      ++h->stats.reads;
+   h->stats.copiedBytes += to - from;
+   dict_readahead_note( h, i, preFilter, postFilter );
+   dict_mutex_unlock( &h->lock );
+
+   return (long) (to - from);
+}
+
 char *dict_data_read_ (
    dictData *h, unsigned long start, unsigned long size,
    const char *preFilter, const char *postFilter )
 {
    char          *buffer, *pt;
    unsigned long end;
-   int           count;
-   char          *inBuffer;
-   char          outBuffer[OUT_BUFFER_SIZE];
    int           firstChunk, lastChunk;
-   int           firstOffset, lastOffset;
-   int           i, j;
-   int           found, target, lastStamp;
-   static int    stamp = 0;
+   int           i;
 
    end  = start + size;
 
@@ -412,112 +1284,22 @@ char *dict_data_read_ (
 		 " or dzip format (for space savings).\n" );
       break;
    case DICT_TEXT:
-      memcpy( buffer, h->start + start, size );
+      dict_data_fetch( h, buffer, size, start );
+      dict_data_count_read( h, size );
       buffer[size] = '\0';
       break;
    case DICT_DZIP:
-      if (!h->initialized) {
-	 ++h->initialized;
-	 h->zStream.zalloc    = NULL;
-	 h->zStream.zfree     = NULL;
-	 h->zStream.opaque    = NULL;
-	 h->zStream.next_in   = 0;
-	 h->zStream.avail_in  = 0;
-	 h->zStream.next_out  = NULL;
-	 h->zStream.avail_out = 0;
-	 if (inflateInit2( &h->zStream, -15 ) != Z_OK)
-	    err_internal( __func__,
-			  "Cannot initialize inflation engine: %s\n",
-			  h->zStream.msg );
-      }
-      firstChunk  = start / h->chunkLength;
-      firstOffset = start - firstChunk * h->chunkLength;
-      lastChunk   = (end - 1) / h->chunkLength;
-      if (lastChunk < firstChunk) {
-	 lastChunk = firstChunk;
-      }
-      lastOffset  = end - lastChunk * h->chunkLength;
-      PRINTF(DBG_UNZIP,
-	     ("   start = %lu, end = %lu\n"
-	      "firstChunk = %d, firstOffset = %d,"
-	      " lastChunk = %d, lastOffset = %d\n",
-	      start, end, firstChunk, firstOffset, lastChunk, lastOffset ));
-      for (pt = buffer, i = firstChunk; i <= lastChunk; i++) {
-
-				/* Access cache */
-	 found  = 0;
-	 target = 0;
-	 lastStamp = INT_MAX;
-	 for (j = 0; j < DICT_CACHE_SIZE; j++) {
-#if USE_CACHE
-	    if (h->cache[j].chunk == i) {
-	       found  = 1;
-	       target = j;
-	       break;
-	    }
-#endif
-	    if (h->cache[j].stamp < lastStamp) {
-	       lastStamp = h->cache[j].stamp;
-	       target = j;
-	    }
-	 }
-
-	 h->cache[target].stamp = ++stamp;
-	 if (found) {
-	    count = h->cache[target].count;
-	    inBuffer = h->cache[target].inBuffer;
-	 } else {
-	    h->cache[target].chunk = i;
-	    if (!h->cache[target].inBuffer)
-	       h->cache[target].inBuffer = xmalloc( IN_BUFFER_SIZE );
-	    inBuffer = h->cache[target].inBuffer;
-
-	    if (h->chunks[i] >= OUT_BUFFER_SIZE ) {
-	       err_internal( __func__,
-			     "h->chunks[%d] = %d >= %ld (OUT_BUFFER_SIZE)\n",
-			     i, h->chunks[i], OUT_BUFFER_SIZE );
-	    }
-	    memcpy( outBuffer, h->start + h->offsets[i], h->chunks[i] );
-	    dict_data_filter( outBuffer, &count, OUT_BUFFER_SIZE, preFilter );
-	 
-	    h->zStream.next_in   = (Bytef *) outBuffer;
-	    h->zStream.avail_in  = h->chunks[i];
-	    h->zStream.next_out  = (Bytef *) inBuffer;
-	    h->zStream.avail_out = IN_BUFFER_SIZE;
-	    if (inflate( &h->zStream,  Z_PARTIAL_FLUSH ) != Z_OK)
-	       err_fatal( __func__, "inflate: %s\n", h->zStream.msg );
-	    if (h->zStream.avail_in)
-	       err_internal( __func__,
-			     "inflate did not flush (%d pending, %d avail)\n",
-			     h->zStream.avail_in, h->zStream.avail_out );
-	    
-	    count = IN_BUFFER_SIZE - h->zStream.avail_out;
-	    dict_data_filter( inBuffer, &count, IN_BUFFER_SIZE, postFilter );
-
-	    h->cache[target].count = count;
-	 }
-	 
-	 if (i == firstChunk) {
-	    if (i == lastChunk) {
-	       memcpy( pt, inBuffer + firstOffset, lastOffset-firstOffset);
-	       pt += lastOffset - firstOffset;
-	    } else {
-	       if (count != h->chunkLength )
-		  err_internal( __func__,
-				"Length = %d instead of %d\n",
-				count, h->chunkLength );
-	       memcpy( pt, inBuffer + firstOffset,
-		       h->chunkLength - firstOffset );
-	       pt += h->chunkLength - firstOffset;
-	    }
-	 } else if (i == lastChunk) {
-	    memcpy( pt, inBuffer, lastOffset );
-	    pt += lastOffset;
-	 } else {
-	    assert( count == h->chunkLength );
-	    memcpy( pt, inBuffer, h->chunkLength );
-	    pt += h->chunkLength;
-	 }
+      pt = buffer;
+      if (size) {
+	 firstChunk = start / h->chunkLength;
+	 lastChunk  = (end - 1) / h->chunkLength;
+	 PRINTF(DBG_UNZIP,
+		("   start = %lu, end = %lu\n"
+		 "firstChunk = %d, lastChunk = %d\n",
+		 start, end, firstChunk, lastChunk ));
+	 for (i = firstChunk; i <= lastChunk; i++)
+	    pt += dict_data_copy_chunk( h, i, start, end, pt,
+					preFilter, postFilter, NULL );
       }
       *pt = '\0';
       break;
@@ -528,3 +1310,119 @@ char *dict_data_read_ (
    
    return buffer;
 }
+
+void dict_data_stream_open(
+   dictDataStream *stream, dictData *h,
+   unsigned long start, unsigned long size,
+   const char *preFilter, const char *postFilter )
+{
+   assert( h != NULL );
+   memset( stream, 0, sizeof( dictDataStream ) );
+
+   switch (h->type) {
+   case DICT_GZIP:
+      err_fatal( __func__,
+		 "Cannot seek on pure gzip format files.\n"
+		 "Use plain text (for performance)"
+		 " or dzip format (for space savings).\n" );
+      break;
+   case DICT_TEXT:
+      stream->bufferSize = DICT_STREAM_SLICE;
+      break;
+   case DICT_DZIP:
+      stream->bufferSize = h->chunkLength;
+      break;
+   case DICT_UNKNOWN:
+      err_fatal( __func__, "Cannot read unknown file type\n" );
+      break;
+   }
+
+   if (start > h->length)
+      start = h->length;
+   if (size > h->length - start)
+      size = h->length - start;
+
+   stream->data       = h;
+   stream->pos        = start;
+   stream->end        = start + size;
+   stream->preFilter  = preFilter;
+   stream->postFilter = postFilter;
+   if (size)
+      stream->buffer  = xmalloc( stream->bufferSize );
+}
+
+void dict_data_stream_obtain(
+   dictDataStream *stream, const dictDatabase *db, const dictWord *dw )
+{
+   assert( db && dw );
+
+   if (dw->def) {
+      memset( stream, 0, sizeof( dictDataStream ) );
+      stream->def    = dw->def;
+      stream->defLen = -1 == dw->def_size
+		       ? strlen( dw->def ) : (unsigned long) dw->def_size;
+      stream->pos    = 0;
+      stream->end    = stream->defLen + 1; /* with the newline */
+   } else {
+      assert( db->data );
+      dict_data_stream_open( stream, db->data, dw->start, dw->end,
+			     db->prefilter, db->postfilter );
+   }
+}
+
+int dict_data_stream_next(
+   dictDataStream *stream, const char **slice, unsigned long *len )
+{
+   dictData      *h = stream->data;
+   unsigned long n;
+   long          copied;
+
+   if (stream->pos >= stream->end)
+      return 0;
+
+   if (!h) {			/* definition supplied by a plugin */
+      if (stream->pos < stream->defLen) {
+	 *slice = stream->def;
+	 *len   = stream->defLen;
+      } else {
+	 *slice = "\n";
+	 *len   = 1;
+      }
+      stream->pos += *len;
+      return 1;
+   }
+
+   if (h->type == DICT_TEXT) {
+      n = stream->end - stream->pos;
+      if (n > stream->bufferSize)
+	 n = stream->bufferSize;
+      dict_data_fetch( h, stream->buffer, n, stream->pos );
+      dict_data_count_read( h, n );
+   } else {
+      copied = dict_data_copy_chunk( h, stream->pos / h->chunkLength,
+				     stream->pos, stream->end, stream->buffer,
+				     stream->preFilter, stream->postFilter,
+				     stream->error );
+      if (copied < 0)
+	 return -1;
+      n = copied;
+   }
+
+   *slice       = stream->buffer;
+   *len         = n;
+   stream->pos += n;
+   return 1;
+}
+
+void dict_data_stream_catch( dictDataStream *stream, char *error )
+{
+   stream->error = error;
+}
+
+void dict_data_stream_close( dictDataStream *stream )
+{
+   if (stream->buffer)
+      xfree( stream->buffer );
+   stream->buffer = NULL;
+   stream->pos    = stream->end;
+}
@@ -32,6 +32,7 @@ extern dictData *dict_data_open (
 extern void dict_data_close (
    dictData *data);
 
+extern void     dict_data_print_heading( FILE *str );
 extern void     dict_data_print_header( FILE *str, dictData *data );
 extern int      dict_data_zip(
    const char *inFilename, const char *outFilename,
@@ -47,12 +48,82 @@ extern char *dict_data_read_ (
    const char *preFilter,
    const char *postFilter );
 
-#ifndef DICTZIP_WIN32
+/* A read of a range of the uncompressed text that yields it a slice at a
+   time: one chunk for dictzip files, DICT_STREAM_SLICE bytes for plain
+   text.  Only one slice is held in memory, so the first bytes of a large
+   definition can be sent before the rest has been inflated. */
+#define DICT_STREAM_SLICE 0x10000
+
+typedef struct dictDataStream {
+   dictData      *data;		/* NULL for a plugin's definition */
+   unsigned long pos;		/* next byte to yield */
+   unsigned long end;
+   const char    *preFilter;
+   const char    *postFilter;
+   char          *buffer;	/* the current slice */
+   unsigned long bufferSize;
+   const char    *def;		/* plugin's definition */
+   unsigned long defLen;
+   char          *error;	/* see dict_data_stream_catch() */
+} dictDataStream;
+
+/* Start streaming |size| bytes from |start|; the range is clipped to
+   the end of the text. */
+extern void dict_data_stream_open (
+   dictDataStream *stream, dictData *data,
+   unsigned long start, unsigned long size,
+   const char *preFilter, const char *postFilter );
+
+/* Start streaming the definition of |dw|, as dict_data_obtain() would
+   return it. */
+extern void dict_data_stream_obtain (
+   dictDataStream *stream,
+   const dictDatabase *db, const dictWord *dw );
+
+/* Point |slice| at the next |len| bytes; they stay valid until the next
+   call.  Returns 0 once the range is exhausted, or -1 on a corrupt
+   chunk if the stream catches errors. */
+extern int dict_data_stream_next (
+   dictDataStream *stream, const char **slice, unsigned long *len );
+
+/* Report corrupt chunks of the stream in |error| (BUFFERSIZE bytes)
+   instead of exiting. */
+extern void dict_data_stream_catch (
+   dictDataStream *stream, char *error );
+
+extern void dict_data_stream_close (
+   dictDataStream *stream );
+
+/* Inflate every chunk of a dictzip file and check the text against the
+   CRC and length in its trailer.  Returns 0 if they match, or for other
+   types; otherwise -1 with the reason in |error| (BUFFERSIZE bytes). */
+extern int dict_data_verify (
+   dictData *data, char *error );
+
+/* copy the counters of |data| to |stats| */
+extern void dict_data_get_stats (
+   dictData *data, dictDataStats *stats );
+
+/* prefetch up to |chunks| chunks in the background once sequential
+   access is detected; 0 disables readahead */
+extern void dict_data_set_readahead (
+   dictData *data, int chunks );
+
+/* apply a DICT_ADVICE_* access pattern hint to an open data file */
+extern void dict_data_advise (
+   dictData *data, int advice );
+
+/* run |buffer| through the filter named |filter|, see filter.h */
 extern int   dict_data_filter(
    char *buffer, int *len, int maxLength,
    const char *filter );
-#endif
 
 extern int        mmap_mode;
+extern int        pread_mode;
+extern int        advice_mode;
+extern int        hugepage_mode;
+extern int        inflate_pool_max;
+extern int        data_open_max;
+extern unsigned long data_mapped_max;
 
 #endif /* _DATA_H_ */
@@ -27,6 +27,8 @@
 
 #include <zlib.h>
 
+#include "thread.h"
+
 #ifndef DICTZIP_WIN32
 #include <maa.h>
 #else
@@ -45,7 +47,6 @@ static const char * _err_programName = "Dictzip";
 
 #define USE_CACHE 1
 
-#define dict_data_filter( ... )
 #ifdef PRINTF
 #undef PRINTF
 #define PRINTF( ... );
@@ -289,8 +290,19 @@ static void err_internal( const char *routine, const char *format, ... )
 #define DICT_GZIP       2
 #define DICT_DZIP       3
 
+#define DICT_ADVICE_NORMAL     0
+#define DICT_ADVICE_RANDOM     1 /* lookups: no kernel readahead        */
+#define DICT_ADVICE_SEQUENTIAL 2 /* whole-file -d and -t runs           */
+
 #define DICT_CACHE_SIZE 5
 
+				/* Readahead starts after this many
+                                   consecutive chunk reads and never keeps
+                                   more chunks in flight than the cache
+                                   can hold beside the current one. */
+#define DICT_READAHEAD_TRIGGER 2
+#define DICT_READAHEAD_MAX     (DICT_CACHE_SIZE - 1)
+
 typedef struct dictCache {
    int           chunk;
    char          *inBuffer;
@@ -298,6 +310,37 @@ typedef struct dictCache {
    int           count;
 } dictCache;
 
+/* Counters kept by each handle under its lock; dict_data_get_stats()
+   takes a copy.  Byte counts are doubles, as long is 32 bits on Win32. */
+typedef struct dictDataStats {
+   unsigned long reads;		/* ranges read, and stream slices */
+   unsigned long hits;		/* chunks found in the cache */
+   unsigned long misses;	/* chunks inflated by the reader */
+   unsigned long prefetches;	/* chunks inflated by readahead */
+   unsigned long evictions;	/* cached chunks replaced */
+   double        inflatedBytes;	/* bytes produced by inflate */
+   double        inflateSeconds;
+   double        copiedBytes;	/* bytes copied out to callers */
+} dictDataStats;
+
+typedef struct dictReadahead {
+   int           window;	/* chunks to prefetch, 0 disables readahead */
+   int           lastChunk;	/* last chunk read, for sequential detection */
+   int           sequential;	/* consecutive sequential reads so far */
+   int           next;		/* next chunk the prefetcher should inflate */
+   int           last;		/* last chunk of the prefetch window */
+   int           inflight;	/* chunk being inflated in background or -1 */
+   int           waiters;	/* readers blocked on the inflight chunk */
+   int           running;	/* prefetch thread has been started */
+   int           stop;		/* prefetch thread should exit */
+   char          *spare;	/* buffer the next chunk is inflated into */
+   const char    *preFilter;	/* filters of the read that moved window */
+   const char    *postFilter;
+   dictSemaphore wake;		/* posted when the window moves */
+   dictSemaphore done;		/* posted once per waiter after inflate */
+   dictThread    thread;
+} dictReadahead;
+
 typedef struct dictData {
    int           fd;		/* file descriptor */
    const char    *start;	/* start of mmap'd area */
@@ -306,8 +349,6 @@ typedef struct dictData {
    
    int           type;
    const char    *filename;
-   z_stream      zStream;
-   int           initialized;
 
    int           headerLength;
    int           method;
@@ -318,6 +359,7 @@ typedef struct dictData {
    int           version;
    int           chunkLength;
    int           chunkCount;
+   int           transform;	/* DICT_TRANSFORM_* of the chunks */
    int           *chunks;
    unsigned long *offsets;	/* Sum-scan of chunks. */
    const char    *origFilename;
@@ -325,7 +367,22 @@ typedef struct dictData {
    unsigned long crc;
    unsigned long length;
    unsigned long compressedLength;
+   int           mapped;	/* file is open (and mapped or loaded) */
+   int           managed;	/* opened on demand by the handle manager */
+   int           users;		/* reads keeping a managed file open */
+   int           mapping;	/* a reader is opening the managed file */
+   int           mapWaiters;	/* readers waiting for it to be open */
+   dictSemaphore mapDone;
+   struct dictData *lruPrev;	/* handle manager LRU links */
+   struct dictData *lruNext;
+   int           advice;	/* DICT_ADVICE_* in effect */
    dictCache     cache[DICT_CACHE_SIZE];
+   char          *cacheRegion;	/* huge-page backing of chunk buffers */
+   unsigned long cacheRegionSize;
+   int           stamp;		/* LRU clock for cache */
+   dictMutex     lock;		/* guards cache and readahead */
+   dictReadahead readahead;
+   dictDataStats stats;		/* guarded by lock */
 } dictData;
 
 typedef struct dictPlugin {
@@ -359,6 +416,8 @@ typedef struct dictIndex {
    int    flag_casesensitive;/* not zero if it has 00-database-case-sensitive entry*/
 
    const int     *isspacealnum;
+
+   struct dictBinIndex *bin;	 /* compiled sidecar, if one was found */
 } dictIndex;
 
 typedef struct dictDatabase {
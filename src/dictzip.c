@@ -20,6 +20,14 @@
 
 #include "dictzip.h"
 #include "data.h"
+#include "index.h"
+#include "binindex.h"
+#include "build.h"
+#include "thread.h"
+#include "transform.h"
+#include "serve.h"
+#include "batch.h"
+#include "grep.h"
 
 #include <sys/stat.h>
 #include <stdlib.h>
@@ -51,19 +59,18 @@ static void xfclose(FILE *stream)
    }
 }
 
+void dict_data_print_heading( FILE *str )
+{
+   fprintf( str,
+	    "type   crc        date    time chunks  size     compr."
+	    "  uncompr. ratio name\n" );
+}
+
 void dict_data_print_header( FILE *str, dictData *header )
 {
    char        *date, *year;
    long        ratio, num, den;
-   static int  first = 1;
 
-   if (first) {
-      fprintf( str,
-	       "type   crc        date    time chunks  size     compr."
-	       "  uncompr. ratio name\n" );
-      first = 0;
-   }
-   
    switch (header->type) {
    case DICT_TEXT:
       date = ctime( &header->mtime ) + 4; /* no day of week */
@@ -126,11 +133,44 @@ void dict_data_print_header( FILE *str, dictData *header )
    }
 }
 
+/* A chunk on its way from the input to the deflater.  With a
+   pre-compression filter or a transform, chunks are filtered and
+   transformed on a pool while earlier ones are deflated;
+   DICT_ZIP_AHEAD chunks per thread may be read ahead. */
+#define DICT_ZIP_AHEAD 2
+
+typedef struct dictZipChunk {
+   dictTask      task;
+   char          *buffer;	/* IN_BUFFER_SIZE bytes */
+   int           count;
+   char          *coded;	/* transformed, if that made it shorter */
+   int           codedCount;	/* or -1 */
+   const char    *filter;
+   dictSemaphore done;
+} dictZipChunk;
+
+static void dict_zip_filter( void *arg )
+{
+   dictZipChunk *c = arg;
+
+   dict_data_filter( c->buffer, &c->count, IN_BUFFER_SIZE, c->filter );
+   c->codedCount = -1;
+   if (transform_mode)
+      c->codedCount = dict_transform_encode( transform_mode,
+					     c->buffer, c->count,
+					     c->coded, IN_BUFFER_SIZE );
+   dict_semaphore_post( &c->done );
+}
+
 int dict_data_zip( const char *inFilename, const char *outFilename,
 		   const char *preFilter, const char *postFilter )
 {
-   char          inBuffer[IN_BUFFER_SIZE];
    char          outBuffer[OUT_BUFFER_SIZE];
+   dictPool      *pool = NULL;
+   dictZipChunk  *window, *c;
+   int           windowSize = 1;
+   unsigned long queued = 0;
+   int           eof    = 0;
    int           count;
    unsigned long inputCRC = crc32( 0L, Z_NULL, 0 );
    z_stream      zStream;
@@ -153,6 +193,11 @@ int dict_data_zip( const char *inFilename, const char *outFilename,
    char          tail[8];
    char          *pt, *origFilename;
 
+				/* a reader could not tell transformed
+                                   chunks by their length */
+   if (transform_mode && preFilter)
+      err_fatal( __func__,
+		 "Cannot transform pre-filtered text\n" );
    
    /* Open files */
    if (!(inStr = fopen( inFilename, "rb" )))
@@ -195,7 +240,7 @@ int dict_data_zip( const char *inFilename, const char *outFilename,
 			(unsigned long) st.st_size ));
    dataLength   = chunks * 2;
 
-   extraLength  = 10 + dataLength;
+   extraLength  = 10 + dataLength + (transform_mode ? 2 : 0);
    if (extraLength > 0xFFFF) {
      fprintf(stderr,"\nFile too long: %u chunks needed, 32762 allowed\n", chunks);
      fclose(inStr);
@@ -232,53 +277,105 @@ int dict_data_zip( const char *inFilename, const char *outFilename,
    header[GZ_SUBLEN+1]   = ((extraLength - 4) & 0xff00) >> 8;
    header[GZ_SUBLEN+0]   = ((extraLength - 4) & 0x00ff) >> 0;
    header[GZ_VERSION+1]  = 0;
-   header[GZ_VERSION+0]  = 1;
+   header[GZ_VERSION+0]  = transform_mode ? 2 : 1;
    header[GZ_CHUNKLEN+1] = (chunkLength & 0xff00) >> 8;
    header[GZ_CHUNKLEN+0] = (chunkLength & 0x00ff) >> 0;
    header[GZ_CHUNKCNT+1] = (chunks & 0xff00) >> 8;
    header[GZ_CHUNKCNT+0] = (chunks & 0x00ff) >> 0;
+   if (transform_mode) {
+      header[GZ_RNDDATA + dataLength + 1] = (transform_mode & 0xff00) >> 8;
+      header[GZ_RNDDATA + dataLength + 0] = (transform_mode & 0x00ff) >> 0;
+   }
    strcpy( &header[GZ_FEXTRA_START + extraLength], origFilename );
    xfwrite( header, 1, headerLength, outStr );
     
    /* Read, compress, write */
-   while (!feof( inStr )) {
-      if ((count = fread( inBuffer, 1, chunkLength, inStr ))) {
-	 dict_data_filter( inBuffer, &count, IN_BUFFER_SIZE, preFilter );
+   if (preFilter || transform_mode) {
+      pool       = dict_pool_create( dict_cpu_count() );
+      windowSize = DICT_ZIP_AHEAD * pool->count;
+   }
+   window = xmalloc( windowSize * sizeof( dictZipChunk ) );
+   for (i = 0; i < windowSize; i++) {
+      window[i].buffer     = xmalloc( IN_BUFFER_SIZE );
+      window[i].coded      = transform_mode ? xmalloc( IN_BUFFER_SIZE ) : NULL;
+      window[i].codedCount = -1;
+      window[i].filter     = preFilter;
+      dict_semaphore_init( &window[i].done, 0 );
+   }
+
+   for (;;) {
+				/* keep the window full */
+      while (!eof && queued - chunk < (unsigned long) windowSize) {
+	 c = &window[queued % windowSize];
+	 if ((c->count = fread( c->buffer, 1, chunkLength, inStr ))) {
+	    ++queued;
+	    if (pool) {
+	       c->task.fn  = dict_zip_filter;
+	       c->task.arg = c;
+	       dict_pool_submit( pool, &c->task );
+	    }
+	 }
+	 if (ferror( inStr ))
+	    err_fatal_errno( __func__,
+			     "Cannot read \"%s\"\n", inFilename );
+	 eof = feof( inStr );
+      }
+      if (chunk == queued)
+	 break;
+
+      c = &window[chunk % windowSize];
+      if (pool)
+	 dict_semaphore_wait( &c->done );
+      count = c->count;
 
-	 inputCRC = crc32( inputCRC, (const Bytef *) inBuffer, count );
-	 zStream.next_in   = (Bytef *) inBuffer;
+      inputCRC = crc32( inputCRC, (const Bytef *) c->buffer, count );
+      if (c->codedCount >= 0) {
+	 zStream.next_in   = (Bytef *) c->coded;
+	 zStream.avail_in  = c->codedCount;
+      } else {
+	 zStream.next_in   = (Bytef *) c->buffer;
 	 zStream.avail_in  = count;
-	 zStream.next_out  = (Bytef *) outBuffer;
-	 zStream.avail_out = OUT_BUFFER_SIZE;
-	 if (deflate( &zStream, Z_FULL_FLUSH ) != Z_OK)
-	    err_fatal( __func__, "deflate: %s\n", zStream.msg );
-	 assert( zStream.avail_in == 0 );
-	 len = OUT_BUFFER_SIZE - zStream.avail_out;
-	 assert( len <= 0xffff );
-
-	 dict_data_filter( outBuffer, &len, OUT_BUFFER_SIZE, postFilter );
-	 
-	 assert( len <= 0xffff );
-	 header[GZ_RNDDATA + chunk*2 + 1] = (len & 0xff00) >>  8;
-	 header[GZ_RNDDATA + chunk*2 + 0] = (len & 0x00ff) >>  0;
-	 xfwrite( outBuffer, 1, len, outStr );
-
-	 ++chunk;
-	 total += count;
+      }
+      zStream.next_out  = (Bytef *) outBuffer;
+      zStream.avail_out = OUT_BUFFER_SIZE;
+      if (deflate( &zStream, Z_FULL_FLUSH ) != Z_OK)
+	 err_fatal( __func__, "deflate: %s\n", zStream.msg );
+      assert( zStream.avail_in == 0 );
+      len = OUT_BUFFER_SIZE - zStream.avail_out;
+      assert( len <= 0xffff );
+
+      dict_data_filter( outBuffer, &len, OUT_BUFFER_SIZE, postFilter );
+
+      assert( len <= 0xffff );
+      header[GZ_RNDDATA + chunk*2 + 1] = (len & 0xff00) >>  8;
+      header[GZ_RNDDATA + chunk*2 + 0] = (len & 0x00ff) >>  0;
+      xfwrite( outBuffer, 1, len, outStr );
+
+      ++chunk;
+      total += count;
 #ifdef _DEBUG
-	    printf( "chunk %5lu: %lu of %lu total\r",
-		    chunk, total, (unsigned long) st.st_size );
-	    xfflush( stdout );
+      printf( "chunk %5lu: %lu of %lu total\r",
+	      chunk, total, (unsigned long) st.st_size );
+      xfflush( stdout );
 #endif // _DEBUG
-      }
    }
+
+   if (pool)
+      dict_pool_destroy( pool );
+   for (i = 0; i < windowSize; i++) {
+      dict_semaphore_destroy( &window[i].done );
+      if (window[i].coded)
+	 xfree( window[i].coded );
+      xfree( window[i].buffer );
+   }
+   xfree( window );
    PRINTF(DBG_VERBOSE,("total: %lu chunks, %lu bytes\n", chunks, (unsigned long) st.st_size));
     
    /* Write last bit */
 #if 0
    dmalloc_verify(0);
 #endif
-   zStream.next_in   = (Bytef *) inBuffer;
+   zStream.next_in   = Z_NULL;
    zStream.avail_in  = 0;
    zStream.next_out  = (Bytef *) outBuffer;
    zStream.avail_out = OUT_BUFFER_SIZE;
@@ -334,6 +431,39 @@ int dict_data_zip( const char *inFilename, const char *outFilename,
    return 0;
 }
 
+typedef struct dictzipBuild {
+   const char *filename;
+   char       indexFilename[BUFFERSIZE];
+   int        ret;
+   dictThread thread;
+} dictzipBuild;
+
+/* Name the index of |filename| the way dictd expects: "name.index" for
+   "name.dict", "name.dict.dz" or "name.dz". */
+static void build_index_name( dictzipBuild *build, const char *filename )
+{
+   char   *pt;
+   size_t len;
+
+   build->filename = filename;
+   if ((len = strlen( filename )) >= BUFFERSIZE - 6)
+      err_fatal( __func__, "Filename too long: %s\n", filename );
+   pt = build->indexFilename;
+   memcpy( pt, filename, len + 1 );
+   if (len > 3 && !strcmp( pt + len - 3, ".dz" ))
+      pt[len -= 3] = '\0';
+   if (len > 5 && !strcmp( pt + len - 5, ".dict" ))
+      pt[len -= 5] = '\0';
+   strcat( pt, ".index" );
+}
+
+static void build_index_thread( void *arg )
+{
+   dictzipBuild *build = arg;
+
+   build->ret = dict_index_build( build->filename, build->indexFilename, 0 );
+}
+
 static const char *id_string (void)
 {
    static char buffer[BUFFERSIZE];
@@ -385,25 +515,38 @@ static void help( void )
    static const char *help_msg[] = {
       "Usage: dictzip [options] name",
       "",
+      "-b --build-index     also build the .index (only that, for .dz files)",
+      "-C --compact         with -i or -b, write front-coded sidecars",
       "-d --decompress      decompress",
       "-f --force           force overwrite of output file",
       "-h --help            give this help",
+      "-H --hugepages       back chunk caches with huge pages if granted",
+      "-i --index           compile .index files into .index.bin sidecars",
       "-k --keep            do not delete original file",
       "-l --list            list compressed file contents",
       "-L --license         display software license",
       "-c --stdout          write to stdout (decompression only)",
       "-t --test            test compressed file integrity",
+      "-T --tokens          substitute common markup before compressing;",
+      "                     the output is no longer plain gzip",
       "-v --verbose         verbose mode",
       "-V --version         display version number",
-#ifndef DICTZIP_WIN32
-      "-D --debug           select debug option",
       "-s --start <offset>  starting offset for decompression (decimal)",
       "-e --size <offset>   size for decompression (decimal)",
+#ifndef DICTZIP_WIN32
+      "-D --debug           select debug option",
       "-S --Start <offset>  starting offset for decompression (base64)",
       "-E --Size <offset>   size for decompression (base64)",
+#endif // !DICTZIP_WIN32
       "-p --pre <filter>    pre-compression filter",
       "-P --post <filter>   post-compression filter",
-#endif // !DICTZIP_WIN32
+      "-R --serve <socket>  answer requests for the named files on a socket",
+      "-B --batch           extract the \"file start size\" ranges read from stdin",
+      "-G --grep <text>     print the offsets at which <text> occurs",
+      "-N --base64          with -B or -G, offsets and sizes are in base64",
+      "-Z --delimit <text>  with -B, end ranges with <text> (\\n, \\t, \\0)",
+      "                     instead of starting them with their length",
+      "   --stats           print cache and inflate counters after -c, -d or -t",
       0 };
    const char        **p = help_msg;
 
@@ -411,40 +554,400 @@ static void help( void )
    while (*p) fprintf( stderr, "%s\n", *p++ );
 }
 
+/* Copy |size| bytes of the text of |header| from |start| to |str|, a
+   chunk at a time. */
+static void write_range(
+   FILE *str, dictData *header,
+   unsigned long start, unsigned long size,
+   const char *pre, const char *post )
+{
+   dictDataStream stream;
+   const char     *slice;
+   unsigned long  len;
+
+   dict_data_stream_open( &stream, header, start, size, pre, post );
+   while (dict_data_stream_next( &stream, &slice, &len )) {
+      xfwrite( slice, len, 1, str );
+      xfflush( str );
+   }
+   dict_data_stream_close( &stream );
+}
+
+#define DICTZIP_STATS 256	/* --stats has no short form */
+
+/* Print the counters of a file read by -c, -d or -t to stderr. */
+static void print_stats( const char *filename, const dictDataStats *s )
+{
+   fprintf( stderr, "%s: %lu reads, %lu hits, %lu misses, %lu prefetched,"
+	    " %lu evicted\n",
+	    filename, s->reads, s->hits, s->misses, s->prefetches,
+	    s->evictions );
+   fprintf( stderr, "%s: %.0f bytes inflated in %.3f s", filename,
+	    s->inflatedBytes, s->inflateSeconds );
+   if (s->inflateSeconds > 0)
+      fprintf( stderr, " (%.1f MB/s)",
+	       s->inflatedBytes / s->inflateSeconds / (1024 * 1024) );
+   fprintf( stderr, ", %.0f bytes copied\n", s->copiedBytes );
+}
+
+/* Where matches found by dict_grep() are printed. */
+typedef struct dictzipGrep {
+   const char *filename;	/* printed before each offset, or NULL */
+   int        base64;
+} dictzipGrep;
+
+static void print_match( void *arg, unsigned long offset )
+{
+   dictzipGrep *grep = arg;
+
+   if (grep->filename)
+      printf( "%s:", grep->filename );
+   if (grep->base64)
+      printf( "%s\n", b64_encode( offset ) );
+   else
+      printf( "%lu\n", offset );
+}
+
+/* Print the offsets of |pattern| in each of the |count| |filenames|,
+   prefixed with the filename if there are several.  Returns 0 if there
+   was a match, as grep does. */
+static int grep_files(
+   const char *pattern, int base64, char **filenames, int count )
+{
+   dictzipGrep   grep;
+   dictData      *header;
+   unsigned long matches = 0;
+   int           i;
+
+   if (!*pattern)
+      err_fatal( __func__, "Cannot search for an empty string\n" );
+
+   grep.base64 = base64;
+   for (i = 0; i < count; i++) {
+      grep.filename = count > 1 ? filenames[i] : NULL;
+      header        = dict_data_open( filenames[i], 0 );
+      matches      += dict_grep( header, pattern, strlen( pattern ), 0,
+				 print_match, &grep );
+      dict_data_close( header );
+   }
+   return !matches;
+}
+
+/* How files are listed, tested or decompressed by run_files(). */
+typedef struct dictzipRun {
+   int           list;
+   int           test;
+   int           keep;
+   int           force;
+   int           stats;		/* print the counters of each file */
+   unsigned long size;
+   const char    *pre;
+   const char    *post;
+   int           headed;	/* the list heading has been printed */
+   int           failed;	/* a file failed the test */
+   dictMutex     lock;
+   int           stopped;	/* guarded by lock: a file could not be
+				   decompressed, start no others */
+} dictzipRun;
+
+typedef struct dictzipJob {
+   dictTask      task;
+   dictzipRun    *run;
+   const char    *filename;
+   char          output[BUFFERSIZE];	/* where it is decompressed to */
+   dictData      *header;	/* kept open until it is listed */
+   int           corrupt;	/* failed the test, |error| says why */
+   int           skipped;	/* not started after another failed */
+   dictDataStats stats;
+   char          error[2 * BUFFERSIZE];	/* why it could not be done */
+   dictSemaphore done;
+} dictzipJob;
+
+/* Name the output of |job| and check that it can be written, before any
+   file is decompressed, so that a bad argument stops the run the way it
+   did when files were decompressed one after the other. */
+static void check_output( dictzipJob *job, int force )
+{
+   dictData *header;
+   FILE     *str;
+   char     *pt;
+   size_t   len;
+
+   if ((len = strlen( job->filename )) >= BUFFERSIZE)
+      err_fatal( __func__, "Filename too long: %s\n", job->filename );
+   memcpy( job->output, job->filename, len + 1 );
+   if ((pt = strrchr( job->output, '.' ))) *pt = '\0';
+   else
+      err_fatal( __func__, "Cannot truncate filename\n" );
+   if (!force && (str = fopen( job->output, "rb" ))) {
+      fclose( str );
+      err_fatal( __func__, "%s already exists\n", job->output );
+   }
+
+   header = dict_data_open( job->filename, 0 );
+   if (header->type != DICT_TEXT && header->type != DICT_DZIP)
+      err_fatal( __func__, "Cannot decompress %s\n", job->filename );
+   dict_data_close( header );
+}
+
+/* Decompress |job| to its output.  Errors are left in |job->error|, with
+   the partial output removed, so that the other files being decompressed
+   are finished before the run stops. */
+static void decompress_file( dictzipJob *job )
+{
+   dictzipRun     *run = job->run;
+   unsigned long  size = run->size;
+   dictData       *header;
+   dictDataStream stream;
+   const char     *slice;
+   unsigned long  len;
+   FILE           *str;
+   int            more;
+   char           reason[BUFFERSIZE];	/* why a chunk is corrupt */
+
+   if (!(str = fopen( job->output, "wb" ))) {
+      snprintf( job->error, sizeof( job->error ),
+		"Cannot open %s for write: %s",
+		job->output, strerror( errno ) );
+      return;
+   }
+
+   header = dict_data_open( job->filename, 0 );
+   dict_data_set_readahead( header, DICT_READAHEAD_MAX );
+   if (!size) size = header->length;
+   dict_data_stream_open( &stream, header, 0, size, run->pre, run->post );
+   dict_data_stream_catch( &stream, reason );
+   while ((more = dict_data_stream_next( &stream, &slice, &len )) > 0) {
+      if (fwrite( slice, 1, len, str ) != len) {
+	 snprintf( job->error, sizeof( job->error ),
+		   "Cannot write %s: %s", job->output, strerror( errno ) );
+	 break;
+      }
+   }
+   dict_data_stream_close( &stream );
+   dict_data_get_stats( header, &job->stats );
+   dict_data_close( header );
+
+   if (more < 0)
+      snprintf( job->error, sizeof( job->error ),
+		"%s: %s", job->filename, reason );
+   if (fclose( str ) && !job->error[0])
+      snprintf( job->error, sizeof( job->error ),
+		"Cannot write %s: %s", job->output, strerror( errno ) );
+   if (job->error[0]) {
+      unlink( job->output );
+      return;
+   }
+
+   if (!run->keep && unlink( job->filename ))
+      snprintf( job->error, sizeof( job->error ), "Cannot unlink %s: %s",
+		job->filename, strerror( errno ) );
+}
+
+static void run_file( void *arg )
+{
+   dictzipJob *job = arg;
+   dictzipRun *run = job->run;
+
+   if (run->list) {
+      job->header = dict_data_open( job->filename, 1 );
+      if (run->test && dict_data_verify( job->header, job->error ))
+	 job->corrupt = 1;
+   } else {
+      dict_mutex_lock( &run->lock );
+      job->skipped = run->stopped;
+      dict_mutex_unlock( &run->lock );
+      if (!job->skipped)
+	 decompress_file( job );
+   }
+
+   dict_semaphore_post( &job->done );
+}
+
+/* List, test or decompress the |count| |filenames| on one thread per
+   CPU.  Results are reported in the order of the files, and only a
+   few files beyond the one reported next are started, which bounds
+   the handles kept open.  If a file cannot be decompressed, no further
+   files are started, and the run stops once those under way are done.
+   Returns nonzero if a file failed the test. */
+static int run_files( dictzipRun *run, char **filenames, int count )
+{
+   dictPool   *pool  = dict_pool_create( dict_cpu_count() );
+   int        window = 2 * pool->count;
+   dictzipJob *jobs  = xmalloc( count * sizeof( dictzipJob ) );
+   dictzipJob *job;
+   dictzipJob *failed = NULL;
+   int        next, i;
+
+   if (run->list && !run->headed) {
+      dict_data_print_heading( stdout );
+      run->headed = 1;
+   }
+
+   memset( jobs, 0, count * sizeof( dictzipJob ) );
+   for (i = 0; i < count; i++) {
+      jobs[i].run      = run;
+      jobs[i].filename = filenames[i];
+      if (!run->list)
+	 check_output( &jobs[i], run->force );
+   }
+
+   dict_mutex_init( &run->lock );
+   run->stopped = 0;
+   for (next = i = 0; i < next || (!failed && i < count); i++) {
+      for (; !failed && next < count && next < i + window; next++) {
+	 job           = &jobs[next];
+	 job->task.fn  = run_file;
+	 job->task.arg = job;
+	 dict_semaphore_init( &job->done, 0 );
+	 dict_pool_submit( pool, &job->task );
+      }
+
+      job = &jobs[i];
+      dict_semaphore_wait( &job->done );
+      dict_semaphore_destroy( &job->done );
+      if (job->skipped)
+	 continue;
+      if (job->error[0] && !job->corrupt) {
+	 if (!failed) {
+	    failed = job;
+	    dict_mutex_lock( &run->lock );
+	    run->stopped = 1;
+	    dict_mutex_unlock( &run->lock );
+	 }
+	 continue;
+      }
+      if (job->header) {
+	 dict_data_print_header( stdout, job->header );
+	 dict_data_get_stats( job->header, &job->stats );
+	 dict_data_close( job->header );
+      }
+      if (run->stats && (run->test || !run->list))	/* not -l */
+	 print_stats( job->filename, &job->stats );
+      if (job->corrupt) {
+	 err_warning( __func__, "%s: %s\n", job->filename, job->error );
+	 run->failed = 1;
+      }
+   }
+
+   dict_pool_destroy( pool );
+   dict_mutex_destroy( &run->lock );
+   if (failed)
+      err_fatal( __func__, "%s\n", failed->error );
+   xfree( jobs );
+   return run->failed;
+}
+
+/* Replace the escapes \n, \t, \0 and \\ in |text| in place; returns
+   the resulting length. */
+static int unescape( char *text )
+{
+   char *pt, *to;
+
+   for (pt = to = text; *pt; pt++, to++) {
+      if (*pt != '\\' || !pt[1]) {
+	 *to = *pt;
+	 continue;
+      }
+      switch (*++pt) {
+      case 'n': *to = '\n'; break;
+      case 't': *to = '\t'; break;
+      case '0': *to = '\0'; break;
+      default:  *to = *pt;  break;
+      }
+   }
+   return to - text;
+}
+
+/* Serve the |count| data files in |filenames|.  Each one is a database
+   named after its index, "name" for "name.index", and can answer
+   definition requests if that index exists. */
+static int serve( const char *address, char **filenames, int count )
+{
+   dictDatabase *databases = xmalloc( count * sizeof( dictDatabase ) );
+   dictDatabase **list     = xmalloc( count * sizeof( dictDatabase * ) );
+   dictzipBuild build;
+   char         *name, *pt;
+   FILE         *str;
+   int          i;
+
+   memset( databases, 0, count * sizeof( dictDatabase ) );
+   for (i = 0; i < count; i++) {
+      build_index_name( &build, filenames[i] );
+      if ((pt = strrchr( build.indexFilename, '/' ))
+	  || (pt = strrchr( build.indexFilename, '\\' )))
+	 ++pt;
+      else
+	 pt = build.indexFilename;
+      name = xmalloc( strlen( pt ) + 1 );
+      strcpy( name, pt );
+      name[strlen( name ) - 6] = '\0';	/* ".index" */
+
+      databases[i].databaseName = name;
+      databases[i].dataFilename = filenames[i];
+      databases[i].data         = dict_data_open( filenames[i], 0 );
+      if (databases[i].data->type != DICT_TEXT
+	  && databases[i].data->type != DICT_DZIP)
+	 err_fatal( __func__, "Cannot serve %s\n", filenames[i] );
+      if ((str = fopen( build.indexFilename, "rb" ))) {
+	 fclose( str );
+	 databases[i].index = dict_index_open( build.indexFilename );
+      }
+      list[i] = &databases[i];
+   }
+
+   return dict_serve( address, list, count, 0 );
+}
+
 int main( int argc, char **argv )
 {
    int           c;
    size_t        i;
-   size_t        j;
+   int           batchFlag      = 0;
+   int           base64Flag     = 0;
+   int           buildFlag      = 0;
    int           decompressFlag = 0;
    int           forceFlag      = 0;
+   int           indexFlag      = 0;
    int           keepFlag       = 0;
    int           listFlag       = 0;
    int           stdoutFlag     = 0;
    int           testFlag       = 0;
    int           verboseFlag    = 0;
    char          buffer[BUFFERSIZE];
-   char          *buf;
    char          *pre           = NULL;
    char          *post          = NULL;
+   const char    *serveAddress  = NULL;
+   const char    *delimiter     = NULL;
+   const char    *grepPattern   = NULL;
+   int           delimiterLength = 0;
    unsigned long start          = 0;
    unsigned long size           = 0;
    unsigned long clSize         = 0; /* from command line */
    unsigned long clStart        = 0; /* from comment line */
    dictData      *header;
    char          *pt;
-   FILE          *str;
    int           len;
-   char          filename[BUFFERSIZE];
+   int           ret;
+   dictzipBuild  build;
+   dictzipRun    run;
+   int           failed         = 0;
+   int           statsFlag      = 0;
+   dictDataStats stats;
    struct option longopts[] = {
       { "stdout",       0, 0, 'c' },
+      { "build-index",  0, 0, 'b' },
+      { "compact",      0, 0, 'C' },
       { "decompress",   0, 0, 'd' },
       { "force",        0, 0, 'f' },
       { "help",         0, 0, 'h' },
+      { "hugepages",    0, 0, 'H' },
+      { "index",        0, 0, 'i' },
       { "keep",         0, 0, 'k' },
       { "list",         0, 0, 'l' },
       { "license",      0, 0, 'L' },
       { "test",         0, 0, 't' },
+      { "tokens",       0, 0, 'T' },
       { "verbose",      0, 0, 'v' },
       { "version",      0, 0, 'V' },
       { "debug",        1, 0, 'D' },
@@ -454,6 +957,12 @@ int main( int argc, char **argv )
       { "Size",         1, 0, 'E' },
       { "pre",          1, 0, 'p' },
       { "post",         1, 0, 'P' },
+      { "serve",        1, 0, 'R' },
+      { "batch",        0, 0, 'B' },
+      { "base64",       0, 0, 'N' },
+      { "delimit",      1, 0, 'Z' },
+      { "grep",         1, 0, 'G' },
+      { "stats",        0, 0, DICTZIP_STATS },
       { 0,              0, 0,  0  }
    };
 
@@ -479,92 +988,116 @@ int main( int argc, char **argv )
 #endif
 
    while ((c = getopt_long( argc, argv,
-			    "cdfhklLe:E:s:S:tvVD:p:P:",
+			    "bBcCdfhHiklLe:E:s:S:tTvVD:p:P:R:NZ:G:",
 			    longopts, NULL )) != EOF)
       switch (c) {
+      case 'b': ++buildFlag;                                           break;
+      case 'C': compact_mode = 1;                                      break;
       case 'd': ++decompressFlag;                                      break;
       case 'f': ++forceFlag;                                           break;
+      case 'H': hugepage_mode = 1;                                     break;
+      case 'i': ++indexFlag;                                           break;
       case 'k': ++keepFlag;                                            break;
       case 'l': ++listFlag;                                            break;
       case 'L': license(); exit( 1 );                                  break;
       case 'c': ++stdoutFlag;                                          break;
       case 't': ++testFlag;                                            break;
+      case 'T': transform_mode = DICT_TRANSFORM_TOKENS;                break;
       case 'v': ++verboseFlag;                                         break;
       case 'V': banner(); exit( 1 );                                   break;
       case 's': ++decompressFlag; clStart = strtoul( optarg, NULL, 10 ); break;
       case 'e': ++decompressFlag; clSize  = strtoul( optarg, NULL, 10 ); break;
+      case 'p': pre = optarg;                                          break;
+      case 'P': post = optarg;                                         break;
+      case 'R': serveAddress = optarg;                                 break;
+      case 'B': ++batchFlag;                                           break;
+      case 'N': ++base64Flag;                                          break;
+      case 'Z': delimiterLength = unescape( optarg );
+		delimiter       = optarg;                              break;
+      case 'G': grepPattern = optarg;                                  break;
+      case DICTZIP_STATS: ++statsFlag;                                 break;
 #ifndef DICTZIP_WIN32
       case 'D': dbg_set( optarg );                                     break;
       case 'S': ++decompressFlag; clStart = b64_decode( optarg );      break;
       case 'E': ++decompressFlag; clSize  = b64_decode( optarg );      break;
-      case 'p': pre = optarg;                                          break;
-      case 'P': post = optarg;                                         break;
 #endif // !DICTZIP_WIN32
       default:  
       case 'h': help(); exit( 1 );                                     break;
       }
 
    if (testFlag) ++listFlag;
+   if (buildFlag && pre)
+      err_fatal( __func__,
+		 "Cannot build an index of pre-filtered text\n" );
+
+   if (serveAddress)
+      return serve( serveAddress, argv + optind, argc - optind );
+   if (batchFlag)
+      return dict_batch( stdin, stdout, base64Flag,
+			 delimiter, delimiterLength );
+
+				/* Whole-file runs read every chunk once, in
+                                   order; ranges behave like lookups. */
+   if (testFlag || grepPattern || (decompressFlag && !clStart && !clSize))
+      advice_mode = DICT_ADVICE_SEQUENTIAL;
+
+   if (grepPattern)
+      return grep_files( grepPattern, base64Flag,
+			 argv + optind, argc - optind );
+
+   memset( &run, 0, sizeof( run ) );
+   run.list  = listFlag;
+   run.test  = testFlag;
+   run.keep  = keepFlag;
+   run.force = forceFlag;
+   run.stats = statsFlag;
+   run.size  = clSize;
+   run.pre   = pre;
+   run.post  = post;
+				/* files are independent of each other
+                                   unless indexes are built as well */
+   if (!indexFlag && !buildFlag
+       && (listFlag || (decompressFlag && !stdoutFlag)))
+      return run_files( &run, argv + optind, argc - optind );
 
    for (i = optind; i < (size_t) argc; i++) {
       size  = clSize  ? clSize  : 0;
       start = clStart ? clStart : 0;
-      if (listFlag) {
-	 header = dict_data_open( argv[i], 1 );
-	 dict_data_print_header( stdout, header );
-	 dict_data_close( header );
+      if (indexFlag) {
+	 if (dict_index_compile( argv[i] ))
+	    err_fatal( __func__, "Cannot compile %s\n", argv[i] );
+      } else if (buildFlag && (len = strlen( argv[i] )) > 3
+		 && !strcmp( argv[i] + len - 3, ".dz" )) {
+	 build_index_name( &build, argv[i] );
+	 if (dict_index_build( argv[i], build.indexFilename, 0 ))
+	    err_fatal( __func__, "Cannot index %s\n", argv[i] );
+      } else if (listFlag || (decompressFlag && !stdoutFlag)) {
+	 failed |= run_files( &run, argv + i, 1 );
       } else if (decompressFlag) {
-	 if (stdoutFlag) {
-	    header = dict_data_open( argv[i], 0 );
-	    if (!size) size = header->length;
-	    if (!start) {
-	       len = header->chunkLength;
-	       for (j = 0; j < size; j += len) {
-		  if (j + len >= size) len = size - j;
-		  buf = dict_data_read_ ( header, j, len, pre, post );
-		  xfwrite( buf, len, 1, stdout );
-		  xfflush( stdout );
-		  xfree( buf );
-	       }
-	    } else {
-	       buf = dict_data_read_ ( header, start, size, pre, post );
-	       xfwrite( buf, size, 1, stdout );
-	       xfflush( stdout );
-	       xfree( buf );
-	    }
-	    dict_data_close( header );
-	 } else {
-#ifdef DICTZIP_WIN32
-       strncpy_s( filename, BUFFERSIZE, argv[i], _TRUNCATE );
-#else
-       strlcpy( filename, argv[i], BUFFERSIZE );
-#endif // !DICTZIP_WIN32
-
-	    if ((pt = strrchr( filename, '.' ))) *pt = '\0';
-	    else
-	       err_fatal( __func__, "Cannot truncate filename\n" );
-	    if (!forceFlag && (str = fopen( filename, "rb" )))
-	       err_fatal( __func__, "%s already exists\n", filename );
-	    if (!(str = fopen( filename, "wb" )))
-	       err_fatal_errno( __func__,
-				"Cannot open %s for write\n", filename );
-	    header = dict_data_open( argv[i], 0 );
-	    if (!size) size = header->length;
-	    len = header->chunkLength;
-	    for (j = 0; j < size; j += len) {
-	       if (j + len >= size) len = size - j;
-	       buf = dict_data_read_ ( header, j, len, pre, post );
-	       xfwrite( buf, len, 1, str );
-	       xfflush( str );
-	       xfree( buf );
-	    }	    
-	    dict_data_close( header );
-	    if (!keepFlag && unlink( argv[i] ))
-	       err_fatal_errno( __func__, "Cannot unlink %s\n", argv[i] );
+	 header = dict_data_open( argv[i], 0 );
+	 dict_data_set_readahead( header, DICT_READAHEAD_MAX );
+	 if (!size) size = header->length;
+	 write_range( stdout, header, start, size, pre, post );
+	 if (statsFlag) {
+	    dict_data_get_stats( header, &stats );
+	    print_stats( argv[i], &stats );
 	 }
+	 dict_data_close( header );
       } else {
 	 snprintf( buffer,BUFFERSIZE-1, "%s.dz", argv[i] );
-	 if (!dict_data_zip( argv[i], buffer, pre, post )) {
+				/* index the text on other threads
+                                   while it is being deflated */
+	 if (buildFlag) {
+	    build_index_name( &build, argv[i] );
+	    dict_thread_create( &build.thread, build_index_thread, &build );
+	 }
+	 ret = dict_data_zip( argv[i], buffer, pre, post );
+	 if (buildFlag) {
+	    dict_thread_join( build.thread );
+	    if (build.ret)
+	       err_fatal( __func__, "Cannot index %s\n", argv[i] );
+	 }
+	 if (!ret) {
 	    if (!keepFlag && unlink( argv[i] ))
 		err_fatal_errno( __func__, "Cannot unlink %s\n", argv[i] );
 	 } else {
@@ -573,5 +1106,5 @@ int main( int argc, char **argv )
       }
    }
 
-   return 0;
+   return failed;
 }
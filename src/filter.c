@@ -0,0 +1,87 @@
+/* filter.c -- In-process chunk filters
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "defs.h"
+#include "filter.h"
+#include "thread.h"
+
+typedef struct dictFilter {
+   char               *name;
+   dictFilterFunction fn;
+   void               *state;
+   struct dictFilter  *next;
+} dictFilter;
+
+static dictOnce   filterOnce = DICT_ONCE_INIT;
+static dictMutex  filterLock;
+static dictFilter *filters;
+
+static void dict_filter_init( void )
+{
+   dict_mutex_init( &filterLock );
+}
+
+void dict_filter_register(
+   const char *name, dictFilterFunction fn, void *state )
+{
+   dictFilter *f, **prev;
+
+   dict_once( &filterOnce, dict_filter_init );
+
+   dict_mutex_lock( &filterLock );
+   for (prev = &filters; (f = *prev); prev = &f->next)
+      if (!strcmp( f->name, name ))
+	 break;
+   if (!fn) {
+      if (f) {
+	 *prev = f->next;
+	 xfree( f->name );
+	 xfree( f );
+      }
+   } else {
+      if (!f) {
+	 f       = xmalloc( sizeof( dictFilter ) );
+	 f->name = xmalloc( strlen( name ) + 1 );
+	 strcpy( f->name, name );
+	 f->next = filters;
+	 filters = f;
+      }
+      f->fn    = fn;
+      f->state = state;
+   }
+   dict_mutex_unlock( &filterLock );
+}
+
+int dict_filter_find(
+   const char *name, dictFilterFunction *fn, void **state )
+{
+   dictFilter *f;
+
+   dict_once( &filterOnce, dict_filter_init );
+
+   dict_mutex_lock( &filterLock );
+   for (f = filters; f; f = f->next)
+      if (!strcmp( f->name, name )) {
+	 *fn    = f->fn;
+	 *state = f->state;
+	 break;
+      }
+   dict_mutex_unlock( &filterLock );
+
+   return f != NULL;
+}
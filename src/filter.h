@@ -0,0 +1,48 @@
+/* filter.h -- In-process chunk filters
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+/* The -p and -P filters, and a database's prefilter and postfilter, are
+   applied to one chunk at a time.  A name registered here is run in
+   process; any other name is run as an external command where the
+   platform supports it.
+
+   When compressing, the pre-compression filter sees the text and the
+   post-compression filter the deflated chunk.  When reading, the
+   prefilter sees the deflated chunk and the postfilter the inflated
+   text, so each should undo its counterpart.
+
+   Chunks are filtered on several threads at once and in no particular
+   order, so a filter must keep no per-chunk state in |state|. */
+
+/* Filter |inLength| bytes from |in| into |out|, which has room for
+   |outMax| bytes.  Returns the length of the output, or -1 on error. */
+typedef int (*dictFilterFunction)(
+   void *state, const char *in, int inLength, char *out, int outMax );
+
+/* Register |fn| under |name|, replacing any filter of that name; a NULL
+   |fn| removes it.  |name| is copied. */
+extern void dict_filter_register (
+   const char *name, dictFilterFunction fn, void *state );
+
+/* Look up |name|; returns 0 if nothing is registered under it. */
+extern int dict_filter_find (
+   const char *name, dictFilterFunction *fn, void **state );
+
+#endif /* _FILTER_H_ */
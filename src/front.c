@@ -0,0 +1,273 @@
+/* front.c -- Front-coded blocks of index records
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "front.h"
+
+#define DICT_FRONT_MAX_NUMBER 5		/* bytes in an encoded u32 */
+
+static unsigned char *dict_front_put( unsigned char *pt, unsigned long val )
+{
+   while (val >= 0x80) {
+      *pt++ = (unsigned char) ((val & 0x7f) | 0x80);
+      val >>= 7;
+   }
+   *pt++ = (unsigned char) val;
+   return pt;
+}
+
+/* Decode a number from [|pt|, |end|); NULL if it runs past |end|. */
+static const unsigned char *dict_front_get(
+   const unsigned char *pt, const unsigned char *end, unsigned long *val )
+{
+   unsigned long v     = 0;
+   int           shift = 0;
+
+   for (; pt < end && shift < 7 * DICT_FRONT_MAX_NUMBER; shift += 7) {
+      v |= (unsigned long) (*pt & 0x7f) << shift;
+      if (!(*pt++ & 0x80)) {
+	 *val = v & 0xffffffffUL;
+	 return pt;
+      }
+   }
+   return NULL;
+}
+
+static unsigned long dict_front_shared( const char *a, const char *b )
+{
+   unsigned long n;
+
+   for (n = 0; a[n] && a[n] == b[n]; n++)
+      ;
+   return n;
+}
+
+unsigned char *dict_front_build(
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length )
+{
+   unsigned long blocks = (count + DICT_FRONT_BLOCK - 1) / DICT_FRONT_BLOCK;
+   unsigned long bound  = 0;
+   unsigned long *offsets;
+   unsigned long shared, len, dataLength, i;
+   unsigned char *data;
+   unsigned char *pt;
+   unsigned char *section;
+   const char    *key, *word;
+   const char    *prevKey  = "";
+   const char    *prevWord = "";
+
+   for (i = 0; i < count; i++)
+      bound += 6 * DICT_FRONT_MAX_NUMBER
+	       + strlen( entries[i].key ) + strlen( entries[i].word );
+
+   data    = xmalloc( bound + 1 );
+   offsets = xmalloc( (blocks + 1) * sizeof( unsigned long ) );
+   for (pt = data, i = 0; i < count; i++) {
+      key  = entries[i].key;
+      word = entries[i].word;
+      if (i % DICT_FRONT_BLOCK == 0) {
+	 offsets[i / DICT_FRONT_BLOCK] = pt - data;
+	 prevKey = prevWord = "";
+      }
+
+      shared = dict_front_shared( prevKey, key );
+      len    = strlen( key + shared );
+      pt     = dict_front_put( pt, shared );
+      pt     = dict_front_put( pt, len );
+      memcpy( pt, key + shared, len );
+      pt    += len;
+
+      if (!strcmp( word, key ))
+	 pt = dict_front_put( pt, 0 );
+      else {
+	 shared = dict_front_shared( prevWord, word );
+	 len    = strlen( word + shared );
+	 pt     = dict_front_put( pt, shared + 1 );
+	 pt     = dict_front_put( pt, len );
+	 memcpy( pt, word + shared, len );
+	 pt    += len;
+      }
+
+      pt = dict_front_put( pt, entries[i].start );
+      pt = dict_front_put( pt, entries[i].size );
+      prevKey  = key;
+      prevWord = word;
+   }
+   dataLength = pt - data;
+
+   *length = DICT_FRONT_HEADER_SIZE + 4 * blocks + dataLength;
+   section = xmalloc( *length + 1 );
+   dict_bin_put_u32( section,      count );
+   dict_bin_put_u32( section + 4,  DICT_FRONT_BLOCK );
+   dict_bin_put_u32( section + 8,  blocks );
+   dict_bin_put_u32( section + 12, dataLength );
+   for (i = 0; i < blocks; i++)
+      dict_bin_put_u32( section + DICT_FRONT_HEADER_SIZE + 4 * i,
+			offsets[i] );
+   memcpy( section + DICT_FRONT_HEADER_SIZE + 4 * blocks, data, dataLength );
+
+   PRINTF(DBG_INIT,("%s: %lu blocks, %lu bytes\n",
+		    __func__, blocks, dataLength));
+
+   xfree( offsets );
+   xfree( data );
+   return section;
+}
+
+int dict_front_valid(
+   const unsigned char *front, unsigned long length, unsigned long headwords )
+{
+   unsigned long count, per, blocks, dataLength, offset, last, i;
+
+   if (length < DICT_FRONT_HEADER_SIZE)
+      return 0;
+   count      = dict_bin_u32( front );
+   per        = dict_bin_u32( front + 4 );
+   blocks     = dict_bin_u32( front + 8 );
+   dataLength = dict_bin_u32( front + 12 );
+   if (count != headwords || !per
+       || blocks != count / per + (count % per != 0)
+       || blocks > (length - DICT_FRONT_HEADER_SIZE) / 4
+       || length != DICT_FRONT_HEADER_SIZE + 4 * blocks + dataLength)
+      return 0;
+   for (last = i = 0; i < blocks; i++, last = offset) {
+      offset = dict_bin_u32( front + DICT_FRONT_HEADER_SIZE + 4 * i );
+      if (offset < last || offset > dataLength)
+	 return 0;
+   }
+   return 1;
+}
+
+/* Bounds of block |block| in the data. */
+static void dict_front_block(
+   const unsigned char *front, unsigned long block,
+   const unsigned char **start, const unsigned char **end )
+{
+   unsigned long       blocks     = dict_bin_u32( front + 8 );
+   unsigned long       dataLength = dict_bin_u32( front + 12 );
+   const unsigned char *offsets   = front + DICT_FRONT_HEADER_SIZE;
+   const unsigned char *data      = offsets + 4 * blocks;
+
+   *start = data + dict_bin_u32( offsets + 4 * block );
+   *end   = data + (block + 1 < blocks
+		    ? dict_bin_u32( offsets + 4 * (block + 1) ) : dataLength);
+}
+
+void dict_front_rewind( dictFrontCursor *cursor )
+{
+   cursor->next = 0;
+}
+
+/* Rebuild the leading |shared| bytes of |dest| (|*destLength| long) from
+   the encoding at |pt|.  Returns where the encoding continues. */
+static const unsigned char *dict_front_string(
+   const unsigned char *pt, const unsigned char *end,
+   unsigned long shared, char *dest, int *destLength )
+{
+   unsigned long len;
+
+   if (!(pt = dict_front_get( pt, end, &len ))
+       || shared > (unsigned long) *destLength
+       || len >= BUFFERSIZE - shared
+       || len > (unsigned long) (end - pt))
+      return NULL;
+   memcpy( dest + shared, pt, len );
+   *destLength = (int) (shared + len);
+   dest[*destLength] = '\0';
+   return pt + len;
+}
+
+int dict_front_next( const unsigned char *front, dictFrontCursor *cursor )
+{
+   unsigned long       count = dict_bin_u32( front );
+   unsigned long       per   = dict_bin_u32( front + 4 );
+   const unsigned char *pt;
+   unsigned long       shared, tag;
+
+   if (cursor->next >= count)
+      return 0;
+   if (cursor->next % per == 0) {
+      dict_front_block( front, cursor->next / per, &cursor->pt, &cursor->end );
+      cursor->keyLength  = 0;
+      cursor->wordLength = 0;
+   }
+
+   if (!(pt = dict_front_get( cursor->pt, cursor->end, &shared ))
+       || !(pt = dict_front_string( pt, cursor->end, shared,
+				    cursor->key, &cursor->keyLength ))
+       || !(pt = dict_front_get( pt, cursor->end, &tag )))
+      return 0;
+   if (!tag) {
+      memcpy( cursor->word, cursor->key, cursor->keyLength + 1 );
+      cursor->wordLength = cursor->keyLength;
+   } else if (!(pt = dict_front_string( pt, cursor->end, tag - 1,
+					cursor->word, &cursor->wordLength )))
+      return 0;
+   if (!(pt = dict_front_get( pt, cursor->end, &cursor->start ))
+       || !(pt = dict_front_get( pt, cursor->end, &cursor->size )))
+      return 0;
+
+   cursor->pt     = pt;
+   cursor->record = cursor->next++;
+   return 1;
+}
+
+static int dict_front_compare(
+   const char *stored, unsigned long len, const char *key, int keyLength )
+{
+   int cmp;
+
+   if ((cmp = memcmp( stored, key,
+		      len < (unsigned long) keyLength ? len : keyLength )))
+      return cmp;
+   return len < (unsigned long) keyLength ? -1 : len > (unsigned long) keyLength;
+}
+
+int dict_front_seek(
+   const unsigned char *front,
+   const char *key, int keyLength,
+   dictFrontCursor *cursor )
+{
+   unsigned long       blocks = dict_bin_u32( front + 8 );
+   unsigned long       l, h, m, shared, len;
+   const unsigned char *pt, *end;
+
+				/* the first block starting at or after
+                                   the key; a malformed one ends the
+                                   search there */
+   for (l = 0, h = blocks; l < h;) {
+      m = l + (h - l) / 2;
+      dict_front_block( front, m, &pt, &end );
+      if ((pt = dict_front_get( pt, end, &shared ))
+	  && (pt = dict_front_get( pt, end, &len ))
+	  && !shared && len <= (unsigned long) (end - pt)
+	  && dict_front_compare( (const char *) pt, len, key, keyLength ) < 0)
+	 l = m + 1;
+      else
+	 h = m;
+   }
+
+				/* equal keys may start in the block
+                                   before it */
+   cursor->next = (l ? l - 1 : 0) * dict_bin_u32( front + 4 );
+   while (dict_front_next( front, cursor ))
+      if (dict_front_compare( cursor->key, cursor->keyLength,
+			      key, keyLength ) >= 0)
+	 return 1;
+   return 0;
+}
@@ -0,0 +1,89 @@
+/* front.h -- Front-coded blocks of index records
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _FRONT_H_
+#define _FRONT_H_
+
+#include "binindex.h"
+
+/* The FRNT section replaces RECS, STRS and KEYS in compact sidecars.
+   Records are cut into blocks of DICT_FRONT_BLOCK, and each record only
+   stores what differs from the one before it in its block:
+
+      records, records per block, blocks, data length
+      block offset[blocks]
+      data
+
+   A record is a sequence of variable-length numbers (7 bits per byte,
+   low bits first) and bytes:
+
+      shared   bytes of the key shared with the previous record
+      length   bytes that follow
+      key bytes
+      word     0 if the headword equals the key, otherwise 1 + bytes
+               shared with the previous headword, then length and bytes
+      start, size
+
+   The first record of a block shares nothing, so its key can be
+   compared in place; a lookup is a binary search over those keys and a
+   scan of at most one block. */
+
+#define DICT_FRONT_HEADER_SIZE 16
+#define DICT_FRONT_BLOCK       16
+
+/* Where a walk over the records stands.  The key and headword of the
+   current record are decoded into the cursor. */
+typedef struct dictFrontCursor {
+   unsigned long       record;		/* current record */
+   unsigned long       next;		/* record decoded next */
+   const unsigned char *pt;		/* its encoding */
+   const unsigned char *end;		/* end of its block */
+   char                key[BUFFERSIZE];
+   int                 keyLength;
+   char                word[BUFFERSIZE];
+   int                 wordLength;
+   unsigned long       start;
+   unsigned long       size;
+} dictFrontCursor;
+
+/* Build the section for the |count| |entries|, which must be sorted by
+   key. */
+extern unsigned char *dict_front_build (
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length );
+
+extern int dict_front_valid (
+   const unsigned char *front, unsigned long length,
+   unsigned long headwords );
+
+/* Position |cursor| before the first record. */
+extern void dict_front_rewind (
+   dictFrontCursor *cursor );
+
+/* Decode the next record into |cursor|.  Returns 0 after the last one,
+   or where the section is malformed. */
+extern int dict_front_next (
+   const unsigned char *front, dictFrontCursor *cursor );
+
+/* Decode into |cursor| the first record whose key is not less than
+   |key|.  Returns 0 if there is none. */
+extern int dict_front_seek (
+   const unsigned char *front,
+   const char *key, int keyLength,
+   dictFrontCursor *cursor );
+
+#endif /* _FRONT_H_ */
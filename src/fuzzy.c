@@ -0,0 +1,214 @@
+/* fuzzy.c -- Levenshtein matching of normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "fuzzy.h"
+#include "trie.h"
+
+/* Characters are decoded a byte at a time, because trie labels can
+   split a UTF-8 sequence.  The query and the headwords go through the
+   same decoder, so malformed input at least behaves consistently. */
+typedef struct dictFuzzyDecoder {
+   unsigned long partial;
+   int           need;		/* continuation bytes still expected */
+} dictFuzzyDecoder;
+
+/* Feed |b| to |d|; return 1 and set |c| when a character is complete. */
+static int dict_fuzzy_decode(
+   int utf8, dictFuzzyDecoder *d, unsigned char b, unsigned long *c )
+{
+   if (!utf8) {
+      *c = b;
+      return 1;
+   }
+   if (d->need) {
+      d->partial = (d->partial << 6) | (b & 0x3f);
+      if (--d->need)
+	 return 0;
+      *c = d->partial;
+      return 1;
+   }
+   if (b < 0xc0 || b >= 0xf8) {
+      *c = b;
+      return 1;
+   }
+   if (b < 0xe0)      { d->partial = b & 0x1f; d->need = 1; }
+   else if (b < 0xf0) { d->partial = b & 0x0f; d->need = 2; }
+   else               { d->partial = b & 0x07; d->need = 3; }
+   return 0;
+}
+
+/* Compute |row| from |prev| after reading |c|; return its minimum. */
+static int dict_fuzzy_step(
+   const dictFuzzy *fuzzy, const int *prev, int *row, unsigned long c )
+{
+   int j, best, v;
+
+   best = row[0] = prev[0] + 1;
+   for (j = 1; j <= fuzzy->length; j++) {
+      v = prev[j - 1] + (fuzzy->query[j - 1] != c);
+      if (prev[j] + 1 < v)
+	 v = prev[j] + 1;
+      if (row[j - 1] + 1 < v)
+	 v = row[j - 1] + 1;
+      row[j] = v;
+      if (v < best)
+	 best = v;
+   }
+   return best;
+}
+
+int dict_fuzzy_init(
+   dictFuzzy *fuzzy, const dictIndex *index,
+   const char *key, int keyLength, int distance )
+{
+   dictFuzzyDecoder d;
+   unsigned long    c;
+   int              i;
+
+   memset( fuzzy, 0, sizeof( dictFuzzy ) );
+   fuzzy->utf8     = index->flag_utf8;
+   fuzzy->distance = distance;
+
+   d.partial = 0;
+   d.need    = 0;
+   for (i = 0; i < keyLength; i++) {
+      if (!dict_fuzzy_decode( fuzzy->utf8, &d, key[i], &c ))
+	 continue;
+      if (fuzzy->length >= DICT_FUZZY_MAX_LENGTH)
+	 return 0;
+      fuzzy->query[fuzzy->length++] = c;
+   }
+   if (d.need) {
+      if (fuzzy->length >= DICT_FUZZY_MAX_LENGTH)
+	 return 0;
+      fuzzy->query[fuzzy->length++] = d.partial;
+   }
+
+   fuzzy->rows = xmalloc( (fuzzy->length + distance + 2)
+			  * (fuzzy->length + 1) * sizeof( int ) );
+   for (i = 0; i <= fuzzy->length; i++)
+      fuzzy->rows[i] = i;
+   return 1;
+}
+
+void dict_fuzzy_free( dictFuzzy *fuzzy )
+{
+   if (fuzzy->rows)
+      xfree( fuzzy->rows );
+   fuzzy->rows = NULL;
+}
+
+int dict_fuzzy_match( dictFuzzy *fuzzy, const char *word, int len )
+{
+   int              width = fuzzy->length + 1;
+   int              depth = 0;
+   int              *row;
+   dictFuzzyDecoder d;
+   unsigned long    c;
+   int              i;
+
+   d.partial = 0;
+   d.need    = 0;
+   for (i = 0; i <= len; i++) {
+      if (i < len) {
+	 if (!dict_fuzzy_decode( fuzzy->utf8, &d, word[i], &c ))
+	    continue;
+      } else if (d.need)
+	 c = d.partial;
+      else
+	 break;
+      if (depth + 1 > fuzzy->length + fuzzy->distance)
+	 return 0;
+      row = fuzzy->rows + depth * width;
+      if (dict_fuzzy_step( fuzzy, row, row + width, c ) > fuzzy->distance)
+	 return 0;
+      ++depth;
+   }
+   return fuzzy->rows[depth * width + fuzzy->length] <= fuzzy->distance;
+}
+
+typedef struct dictFuzzyWalk {
+   dictFuzzy           *fuzzy;
+   const unsigned char *trie;
+   dictFuzzyCallback   callback;
+   void                *arg;
+   int                 stop;
+} dictFuzzyWalk;
+
+/* Read the label of |node| starting from row |depth|, report the
+   headwords that end at it and descend. */
+static void dict_fuzzy_visit(
+   dictFuzzyWalk *walk, const dictTrieNode *node,
+   int depth, dictFuzzyDecoder d )
+{
+   dictFuzzy     *fuzzy = walk->fuzzy;
+   int           width  = fuzzy->length + 1;
+   int           *row;
+   dictTrieNode  child;
+   unsigned long c, i;
+
+   for (i = 0; i < node->labelLength; i++) {
+      if (!dict_fuzzy_decode( fuzzy->utf8, &d, node->label[i], &c ))
+	 continue;
+      if (depth + 1 > fuzzy->length + fuzzy->distance)
+	 return;
+      row = fuzzy->rows + depth * width;
+      if (dict_fuzzy_step( fuzzy, row, row + width, c ) > fuzzy->distance)
+	 return;
+      ++depth;
+   }
+
+   if (node->lo < node->end) {
+      row = fuzzy->rows + depth * width;
+      if (d.need) {			/* headwords ending mid-sequence */
+	 if (depth + 1 <= fuzzy->length + fuzzy->distance) {
+	    dict_fuzzy_step( fuzzy, row, row + width, d.partial );
+	    if (row[width + fuzzy->length] <= fuzzy->distance
+		&& walk->callback( node->lo, node->end, walk->arg ))
+	       walk->stop = 1;
+	 }
+      } else if (row[fuzzy->length] <= fuzzy->distance
+		 && walk->callback( node->lo, node->end, walk->arg ))
+	 walk->stop = 1;
+   }
+
+   for (i = 0; i < node->children && !walk->stop; i++)
+      if (dict_trie_child( walk->trie, node, i, &child ))
+	 dict_fuzzy_visit( walk, &child, depth, d );
+}
+
+void dict_fuzzy_trie(
+   dictFuzzy *fuzzy,
+   const unsigned char *trie, unsigned long headwords,
+   dictFuzzyCallback callback, void *arg )
+{
+   dictFuzzyWalk    walk;
+   dictFuzzyDecoder d;
+   dictTrieNode     root;
+
+   walk.fuzzy    = fuzzy;
+   walk.trie     = trie;
+   walk.callback = callback;
+   walk.arg      = arg;
+   walk.stop     = 0;
+   d.partial     = 0;
+   d.need        = 0;
+
+   dict_trie_root( trie, headwords, &root );
+   dict_fuzzy_visit( &walk, &root, 0, d );
+}
@@ -0,0 +1,68 @@
+/* fuzzy.h -- Levenshtein matching of normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _FUZZY_H_
+#define _FUZZY_H_
+
+#include "index.h"
+
+/* Distances are counted in characters: code points in UTF-8 indexes,
+   bytes otherwise.  Both the query and the headwords are normalized
+   first, so case folding follows the index's flags.
+
+   The matcher is the dynamic-programming form of a Levenshtein
+   automaton: one row of the edit-distance table per character read.  A
+   row whose entries all exceed the distance is a dead state, and
+   everything that would be read after it is skipped.  Walking the trie
+   that way only visits headwords that share a close enough prefix with
+   the query. */
+
+#define DICT_FUZZY_MAX_LENGTH 255	/* longest query, in characters */
+
+typedef struct dictFuzzy {
+   unsigned long query[DICT_FUZZY_MAX_LENGTH];
+   int           length;	/* characters in query */
+   int           distance;
+   int           utf8;
+   int           *rows;		/* length + distance + 2 rows */
+} dictFuzzy;
+
+/* Prepare to match |key| within |distance| edits.  Returns 0, with
+   nothing to free, if the key is too long to match fuzzily. */
+extern int dict_fuzzy_init (
+   dictFuzzy *fuzzy, const dictIndex *index,
+   const char *key, int keyLength, int distance );
+extern void dict_fuzzy_free (
+   dictFuzzy *fuzzy );
+
+/* whether the normalized headword |word| of |len| bytes is close enough */
+extern int dict_fuzzy_match (
+   dictFuzzy *fuzzy, const char *word, int len );
+
+/* Called with each run of matching records, in index order.  A nonzero
+   return ends the walk. */
+typedef int (*dictFuzzyCallback)(
+   unsigned long lo, unsigned long hi, void *arg );
+
+/* Walk a TRIE section, calling |callback| for every headword that is
+   close enough. */
+extern void dict_fuzzy_trie (
+   dictFuzzy *fuzzy,
+   const unsigned char *trie, unsigned long headwords,
+   dictFuzzyCallback callback, void *arg );
+
+#endif /* _FUZZY_H_ */
@@ -0,0 +1,176 @@
+/* grep.c -- Find a string in the text of a data file
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "data.h"
+#include "grep.h"
+#include "thread.h"
+
+#if defined(__SSE2__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DICT_GREP_SSE2 1
+#endif
+
+#define DICT_GREP_PIECE (1024 * 1024)	/* least text scanned per task */
+
+/* One piece of the text: matches starting in [from, to). */
+typedef struct dictGrepPiece {
+   dictTask      task;
+   dictData      *data;
+   const char    *pattern;
+   int           patternLength;
+   unsigned long from, to;
+   unsigned long *offsets;
+   unsigned long count;
+   unsigned long alloc;
+   dictSemaphore done;
+} dictGrepPiece;
+
+/* first match of |pattern| in [|pt|, |end|), or NULL.  With SSE2, 16
+   candidates at a time are those whose first and last bytes both match;
+   only they are compared in full. */
+static const char *dict_grep_find(
+   const char *pt, const char *end, const char *pattern, int len )
+{
+#ifdef DICT_GREP_SSE2
+   const __m128i first = _mm_set1_epi8( pattern[0] );
+   const __m128i last  = _mm_set1_epi8( pattern[len - 1] );
+   int           mask, bit;
+
+   for (; end - pt >= len + 15; pt += 16) {
+      mask = _mm_movemask_epi8( _mm_and_si128(
+	 _mm_cmpeq_epi8( first, _mm_loadu_si128( (const __m128i *) pt ) ),
+	 _mm_cmpeq_epi8( last, _mm_loadu_si128(
+			    (const __m128i *) (pt + len - 1) ) ) ) );
+      for (bit = 0; mask; bit++, mask >>= 1)
+	 if ((mask & 1) && !memcmp( pt + bit, pattern, len ))
+	    return pt + bit;
+   }
+#endif
+   for (; end - pt >= len; pt++) {
+      if (!(pt = memchr( pt, pattern[0], end - pt - len + 1 )))
+	 return NULL;
+      if (!memcmp( pt, pattern, len ))
+	 return pt;
+   }
+   return NULL;
+}
+
+static void dict_grep_add( dictGrepPiece *piece, unsigned long offset )
+{
+   unsigned long *offsets;
+
+   if (piece->count == piece->alloc) {
+      piece->alloc = piece->alloc ? 2 * piece->alloc : 64;
+      offsets = xmalloc( piece->alloc * sizeof( unsigned long ) );
+      if (piece->count) {
+	 memcpy( offsets, piece->offsets,
+		 piece->count * sizeof( unsigned long ) );
+	 xfree( piece->offsets );
+      }
+      piece->offsets = offsets;
+   }
+   piece->offsets[piece->count++] = offset;
+}
+
+static void dict_grep_piece( void *arg )
+{
+   dictGrepPiece *piece = arg;
+   unsigned long end    = piece->to + piece->patternLength - 1;
+   char          *buffer;
+   const char    *pt;
+
+   if (end > piece->data->length)
+      end = piece->data->length;
+   buffer = dict_data_read_( piece->data, piece->from, end - piece->from,
+			     NULL, NULL );
+
+   for (pt = buffer;
+	(pt = dict_grep_find( pt, buffer + (end - piece->from),
+			      piece->pattern, piece->patternLength ));
+	pt++)
+      dict_grep_add( piece, piece->from + (pt - buffer) );
+
+   xfree( buffer );
+   dict_semaphore_post( &piece->done );
+}
+
+unsigned long dict_grep(
+   dictData *data,
+   const char *pattern, int patternLength,
+   int threads,
+   dictGrepFunction fn, void *arg )
+{
+   unsigned long span   = DICT_GREP_PIECE;
+   unsigned long total  = 0;
+   unsigned long count, next, i, j;
+   int           window;
+   dictPool      *pool;
+   dictGrepPiece *pieces;
+   dictGrepPiece *piece;
+
+   if (patternLength <= 0 || !data->length)
+      return 0;
+				/* cut on chunk boundaries, so that each
+                                   chunk is inflated once, except for the
+                                   overlap */
+   if (data->type == DICT_DZIP && data->chunkLength)
+      span = (span + data->chunkLength - 1)
+	     / data->chunkLength * data->chunkLength;
+   count = (data->length + span - 1) / span;
+
+   pool   = dict_pool_create( threads ? threads : dict_cpu_count() );
+   window = 2 * pool->count;
+   pieces = xmalloc( count * sizeof( dictGrepPiece ) );
+   memset( pieces, 0, count * sizeof( dictGrepPiece ) );
+
+				/* results are kept for a few pieces
+                                   ahead of the one reported next */
+   for (next = i = 0; i < count; i++) {
+      for (; next < count && next < i + window; next++) {
+	 piece                = &pieces[next];
+	 piece->data          = data;
+	 piece->pattern       = pattern;
+	 piece->patternLength = patternLength;
+	 piece->from          = next * span;
+	 piece->to            = piece->from + span;
+	 if (piece->to > data->length)
+	    piece->to = data->length;
+	 piece->task.fn       = dict_grep_piece;
+	 piece->task.arg      = piece;
+	 dict_semaphore_init( &piece->done, 0 );
+	 dict_pool_submit( pool, &piece->task );
+      }
+
+      piece = &pieces[i];
+      dict_semaphore_wait( &piece->done );
+      dict_semaphore_destroy( &piece->done );
+      for (j = 0; j < piece->count; j++)
+	 fn( arg, piece->offsets[j] );
+      total += piece->count;
+      if (piece->offsets)
+	 xfree( piece->offsets );
+   }
+
+   PRINTF(DBG_VERBOSE,("%s: %lu matches in %lu pieces\n",
+		       __func__, total, count));
+
+   dict_pool_destroy( pool );
+   xfree( pieces );
+   return total;
+}
@@ -0,0 +1,43 @@
+/* grep.h -- Find a string in the text of a data file
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _GREP_H_
+#define _GREP_H_
+
+#include "defs.h"
+
+/* The text is cut into pieces of whole chunks, and each piece is
+   inflated and scanned on its own thread, together with the first
+   bytes of the next piece so that matches across the cut are found.
+   Offsets are in the uncompressed text, as the start of a dictWord
+   is. */
+
+/* Called with the offset of each match. */
+typedef void (*dictGrepFunction)( void *arg, unsigned long offset );
+
+/* Call |fn| for every offset at which the |patternLength| bytes of
+   |pattern| start in the text of |data|, overlapping matches included.
+   The calls are made in order of offset, on the calling thread.  The
+   scan runs on |threads| threads, or one per CPU if |threads| is 0.
+   Returns the number of matches. */
+extern unsigned long dict_grep (
+   dictData *data,
+   const char *pattern, int patternLength,
+   int threads,
+   dictGrepFunction fn, void *arg );
+
+#endif /* _GREP_H_ */
@@ -0,0 +1,691 @@
+/* index.c -- Lookups in dictd .index files
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "data.h"
+#include "index.h"
+#include "binindex.h"
+#include "fuzzy.h"
+#include "bloom.h"
+
+#include <sys/stat.h>
+#include <ctype.h>
+#include <fcntl.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/* A .index line is "headword TAB base64(start) TAB base64(size) NL", and
+   lines are sorted by the normalized headword (see
+   dict_index_normalize()).  Bytes >= 0x80 always count as alphanumeric,
+   so 8-bit and UTF-8 headwords survive normalization intact. */
+
+static int      isspacealnum_tab[UCHAR_MAX + 1];
+static int      allchars_tab[UCHAR_MAX + 1];
+static dictOnce tabsOnce = DICT_ONCE_INIT;
+
+static void dict_index_init_tabs( void )
+{
+   int c;
+
+   for (c = 0; c <= UCHAR_MAX; c++) {
+      isspacealnum_tab[c] = c >= 0x80 || isspace( c ) || isalnum( c );
+      allchars_tab[c]     = 1;
+   }
+}
+
+void dict_index_set_flags( dictIndex *index )
+{
+   dict_once( &tabsOnce, dict_index_init_tabs );
+   index->isspacealnum =
+      index->flag_allchars ? allchars_tab : isspacealnum_tab;
+}
+
+				/* Simple lowercase mapping for the scripts
+                                   our dictionaries use; anything else is
+                                   left alone. */
+static unsigned long dict_fold_utf8( unsigned long c )
+{
+   if (c < 0x80)
+      return tolower( (int) c );
+   if ((c >= 0xc0 && c <= 0xde && c != 0xd7)	/* Latin-1 */
+       || (c >= 0x391 && c <= 0x3ab && c != 0x3a2) /* Greek */
+       || (c >= 0x410 && c <= 0x42f))		/* Cyrillic */
+      return c + 0x20;
+   if (c >= 0x400 && c <= 0x40f)		/* Cyrillic U+0400-U+040F */
+      return c + 0x50;
+   if (c >= 0x100 && c <= 0x17f) {		/* Latin Extended-A */
+      if (c == 0x130 || c == 0x131 || c == 0x138 || c == 0x149
+	  || c == 0x17f)
+	 return c;
+      if (c == 0x178)
+	 return 0xff;
+      if ((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17e))
+	 return c & 1 ? c + 1 : c;
+      return c & 1 ? c : c + 1;
+   }
+   return c;
+}
+
+/* Decode one UTF-8 sequence at |src| (|len| bytes available) into |*c|
+   and return its length; malformed input decodes one byte as itself. */
+static int dict_utf8_decode( const unsigned char *src, int len,
+			     unsigned long *c )
+{
+   int n, i;
+
+   if (src[0] < 0xc0)      { *c = src[0];        n = 1; }
+   else if (src[0] < 0xe0) { *c = src[0] & 0x1f; n = 2; }
+   else if (src[0] < 0xf0) { *c = src[0] & 0x0f; n = 3; }
+   else if (src[0] < 0xf8) { *c = src[0] & 0x07; n = 4; }
+   else                    { *c = src[0];        n = 1; }
+
+   if (n > len) {
+      *c = src[0];
+      return 1;
+   }
+   for (i = 1; i < n; i++) {
+      if ((src[i] & 0xc0) != 0x80) {
+	 *c = src[0];
+	 return 1;
+      }
+      *c = (*c << 6) | (src[i] & 0x3f);
+   }
+   return n;
+}
+
+static int dict_utf8_encode( unsigned long c, char *dest )
+{
+   if (c < 0x80) {
+      dest[0] = (char) c;
+      return 1;
+   }
+   if (c < 0x800) {
+      dest[0] = (char) (0xc0 | (c >> 6));
+      dest[1] = (char) (0x80 | (c & 0x3f));
+      return 2;
+   }
+   if (c < 0x10000) {
+      dest[0] = (char) (0xe0 | (c >> 12));
+      dest[1] = (char) (0x80 | ((c >> 6) & 0x3f));
+      dest[2] = (char) (0x80 | (c & 0x3f));
+      return 3;
+   }
+   dest[0] = (char) (0xf0 | (c >> 18));
+   dest[1] = (char) (0x80 | ((c >> 12) & 0x3f));
+   dest[2] = (char) (0x80 | ((c >> 6) & 0x3f));
+   dest[3] = (char) (0x80 | (c & 0x3f));
+   return 4;
+}
+
+int dict_index_normalize(
+   const dictIndex *index,
+   const char *src, int len,
+   char *dest, int size )
+{
+   const unsigned char *pt  = (const unsigned char *) src;
+   const unsigned char *end = pt + len;
+   const int           *keep = index->isspacealnum;
+   unsigned long       c;
+   int                 n;
+   int                 out = 0;
+   char                tmp[4];
+
+   while (pt < end) {
+      if (index->flag_utf8 && *pt >= 0x80) {
+	 pt += dict_utf8_decode( pt, (int) (end - pt), &c );
+	 if (!index->flag_casesensitive)
+	    c = dict_fold_utf8( c );
+	 n = dict_utf8_encode( c, tmp );
+	 if (out + n >= size)
+	    break;
+	 memcpy( dest + out, tmp, n );
+	 out += n;
+	 continue;
+      }
+
+      c = *pt++;
+      if (!keep[c])
+	 continue;
+      if (out + 1 >= size)
+	 break;
+      if (c < 0x80 && isspace( (int) c ))
+	 dest[out++] = ' ';
+      else if (!index->flag_casesensitive && (c < 0x80 || index->flag_8bit))
+	 dest[out++] = (char) tolower( (int) c );
+      else
+	 dest[out++] = (char) c;
+   }
+
+   dest[out] = '\0';
+   return out;
+}
+
+static const char *dict_index_line_start(
+   const dictIndex *index, const char *pt )
+{
+   while (pt > index->start && pt[-1] != '\n')
+      --pt;
+   return pt;
+}
+
+static const char *dict_index_next_line(
+   const dictIndex *index, const char *pt )
+{
+   const char *nl = memchr( pt, '\n', index->end - pt );
+
+   return nl ? nl + 1 : index->end;
+}
+
+/* length of the headword at the start of |line| */
+static int dict_index_headword_length(
+   const dictIndex *index, const char *line )
+{
+   const char *pt = line;
+
+   while (pt < index->end && *pt != '\t' && *pt != '\n')
+      ++pt;
+   return (int) (pt - line);
+}
+
+static int dict_index_key(
+   const dictIndex *index, const char *line, char *key, int size )
+{
+   return dict_index_normalize(
+      index, line, dict_index_headword_length( index, line ), key, size );
+}
+
+static int dict_index_has_entry(
+   const dictIndex *index, const char *line, int len, const char *entry )
+{
+   size_t      n = strlen( entry );
+   const char  *pt;
+   char        *squeezed;
+   int         i;
+
+   if ((size_t) len == n && !memcmp( line, entry, n ))
+      return 1;
+
+				/* dictfmt drops the dashes unless the
+                                   database is built with --allchars */
+   squeezed = xmalloc( n + 1 );
+   for (i = 0, pt = entry; *pt; pt++) {
+      if (*pt != '-')
+	 squeezed[i++] = *pt;
+   }
+   squeezed[i] = '\0';
+   n = i;
+   i = (size_t) len == n && !memcmp( line, squeezed, n );
+   xfree( squeezed );
+   return i;
+}
+
+const char *dict_index_map_file(
+   const char *filename, int *fd, unsigned long *size )
+{
+   struct stat sb;
+   const char  *start;
+
+   if ((*fd = open( filename, O_RDONLY | O_BINARY )) < 0)
+      err_fatal_errno( __func__,
+		       "Cannot open index file \"%s\"\n", filename );
+   if (fstat( *fd, &sb ))
+      err_fatal_errno( __func__,
+		       "Cannot stat index file \"%s\"\n", filename );
+   *size = sb.st_size;
+
+   if (!*size)
+      return "";
+
+#if defined(_WIN32) && !defined(HAVE_MMAP)
+   {
+      HANDLE map = CreateFileMapping( (HANDLE) _get_osfhandle( *fd ),
+				      NULL, PAGE_READONLY, 0, 0, NULL );
+
+      if (!map || !(start = MapViewOfFile( map, FILE_MAP_READ, 0, 0, 0 )))
+	 err_fatal( __func__, "Cannot map index file \"%s\" (%lu)\n",
+		    filename, (unsigned long) GetLastError() );
+      CloseHandle( map );	/* the view keeps the mapping alive */
+      return start;
+   }
+#else
+#ifdef HAVE_MMAP
+   if (mmap_mode) {
+      start = mmap( NULL, *size, PROT_READ, MAP_SHARED, *fd, 0 );
+      if ((void *)start == (void *)(-1))
+	 err_fatal_errno( __func__,
+			  "Cannot mmap index file \"%s\"\n", filename );
+      return start;
+   }
+#endif
+
+   {
+      char          *buffer = xmalloc( *size );
+      unsigned long done;
+      int           count;
+
+      for (done = 0; done < *size; done += count) {
+	 if ((count = read( *fd, buffer + done, *size - done )) < 0)
+	    err_fatal_errno( __func__,
+			     "Cannot read index file \"%s\"\n", filename );
+	 if (!count)
+	    err_fatal( __func__,
+		       "Index file \"%s\" ended early\n", filename );
+      }
+      return buffer;
+   }
+#endif
+}
+
+void dict_index_unmap_file(
+   const char *start, unsigned long size, int fd )
+{
+   if (size) {
+#ifdef HAVE_MMAP
+      if (mmap_mode)
+	 munmap( (void *) start, size );
+      else
+	 xfree( (char *) start );
+#elif defined(_WIN32)
+      UnmapViewOfFile( start );
+#else
+      xfree( (char *) start );
+#endif
+   }
+   if (fd >= 0)
+      close( fd );
+}
+
+void dict_index_check_flag(
+   dictIndex *index, const char *headword, int len )
+{
+   if (!len || *headword != '0')
+      return;
+   if (dict_index_has_entry( index, headword, len, DICT_FLAG_UTF8 ))
+      index->flag_utf8 = 1;
+   if (dict_index_has_entry( index, headword, len, DICT_FLAG_8BIT_NEW )
+       || dict_index_has_entry( index, headword, len, DICT_FLAG_8BIT_OLD ))
+      index->flag_8bit = 1;
+   if (dict_index_has_entry( index, headword, len, DICT_FLAG_ALLCHARS ))
+      index->flag_allchars = 1;
+   if (dict_index_has_entry( index, headword, len, DICT_FLAG_CASESENSITIVE ))
+      index->flag_casesensitive = 1;
+}
+
+/* Count the headwords of a mapped .index, find its flags and fill in
+   optStart. */
+static void dict_index_scan( dictIndex *index )
+{
+   const char *pt;
+   char       key[BUFFERSIZE];
+   int        c, last;
+
+				/* Flags decide the collation, so find
+                                   them before computing optStart. */
+   for (pt = index->start; pt < index->end;
+	pt = dict_index_next_line( index, pt ))
+   {
+      ++index->headwords;
+      dict_index_check_flag(
+	 index, pt, dict_index_headword_length( index, pt ) );
+   }
+   dict_index_set_flags( index );
+
+				/* optStart[c] is the first line whose
+                                   normalized headword starts with c, or
+                                   the first line after them if none does. */
+   for (c = 0; c <= UCHAR_MAX + 1; c++)
+      index->optStart[c] = NULL;
+   last = -1;
+   for (pt = index->start; pt < index->end;
+	pt = dict_index_next_line( index, pt ))
+   {
+      dict_index_key( index, pt, key, sizeof( key ) );
+      c = (unsigned char) key[0];
+      if (c > last) {
+	 while (++last <= c)
+	    index->optStart[last] = pt;
+	 last = c;
+      }
+   }
+   while (++last <= UCHAR_MAX + 1)
+      index->optStart[last] = index->end;
+}
+
+dictIndex *dict_index_open( const char *filename )
+{
+   dictIndex  *index;
+
+   index = xmalloc( sizeof( dictIndex ) );
+   memset( index, 0, sizeof( dictIndex ) );
+   index->fd = -1;
+
+   if (!dict_bin_open( index, filename )) {
+      index->start = dict_index_map_file( filename, &index->fd, &index->size );
+      index->end   = index->start + index->size;
+      dict_index_scan( index );
+   }
+
+   PRINTF(DBG_INIT,("%s: %lu headwords%s%s%s%s%s\n",
+		    filename, index->headwords,
+		    index->bin                ? ", compiled"       : "",
+		    index->flag_utf8          ? ", utf8"           : "",
+		    index->flag_8bit          ? ", 8bit"           : "",
+		    index->flag_allchars      ? ", allchars"       : "",
+		    index->flag_casesensitive ? ", case-sensitive" : ""));
+
+   return index;
+}
+
+void dict_index_close( dictIndex *index )
+{
+   if (!index)
+      return;
+
+   dict_bin_close( index );
+   if (index->start)
+      dict_index_unmap_file( index->start, index->size, index->fd );
+   memset( index, 0, sizeof( dictIndex ) );
+   xfree( index );
+}
+
+/* Compare the normalized |key| with the headword of |line|.  With
+   |prefix| set, a headword that starts with |key| compares equal. */
+static int dict_index_compare(
+   const dictIndex *index, const char *key, int keyLength,
+   const char *line, int prefix )
+{
+   char buffer[BUFFERSIZE];
+   int  len = dict_index_key( index, line, buffer, sizeof( buffer ) );
+   int  cmp;
+
+   if (prefix) {
+      cmp = memcmp( key, buffer, keyLength < len ? keyLength : len );
+      return cmp || keyLength <= len ? cmp : 1;
+   }
+   cmp = memcmp( key, buffer, (keyLength < len ? keyLength : len) + 1 );
+   return cmp;
+}
+
+/* Binary search for the first line in [lo, hi) not ordered before |key|. */
+static const char *dict_index_lower_bound(
+   const dictIndex *index, const char *key, int keyLength,
+   const char *lo, const char *hi, int prefix )
+{
+   const char *mid;
+
+   while (lo < hi) {
+      mid = dict_index_line_start( index, lo + (hi - lo) / 2 );
+      if (dict_index_compare( index, key, keyLength, mid, prefix ) > 0)
+	 lo = dict_index_next_line( index, mid );
+      else
+	 hi = mid;
+   }
+   return lo;
+}
+
+/* Fill |dw| from |line|, copying the headword into |word|, which has
+   room for BUFFERSIZE bytes. */
+static void dict_index_fill(
+   const dictIndex *index, const char *line, dictWord *dw, char *word )
+{
+   int        len = dict_index_headword_length( index, line );
+   const char *pt, *field;
+
+   memset( dw, 0, sizeof( dictWord ) );
+   dw->word = word;
+   memcpy( word, line, len < BUFFERSIZE ? len : BUFFERSIZE - 1 );
+   word[len < BUFFERSIZE ? len : BUFFERSIZE - 1] = '\0';
+   dw->def_size = -1;
+
+   pt = field = line + len + 1;
+   while (pt < index->end && *pt != '\t' && *pt != '\n')
+      ++pt;
+   dw->start = b64_decode_buf( field, pt - field );
+
+   field = ++pt;
+   while (pt < index->end && *pt != '\t' && *pt != '\n')
+      ++pt;
+   dw->end = b64_decode_buf( field, pt - field );
+}
+
+int dict_index_match_key(
+   const char *key, int keyLength,
+   const char *word, int len, int strategy, dictFuzzy *fuzzy )
+{
+   if (strategy == DICT_STRAT_LEVENSHTEIN)
+      return dict_fuzzy_match( fuzzy, word, len );
+   if (strategy == DICT_STRAT_SUFFIX)
+      return len >= keyLength
+	 && !memcmp( word + len - keyLength, key, keyLength );
+   return strstr( word, key ) != NULL;
+}
+
+/* dict_index_enumerate() and dict_index_fuzzy(), which only differ in
+   where the edit distance comes from */
+static unsigned long dict_index_walk(
+   const dictIndex *index,
+   const char *word, int strategy, int distance, unsigned long max,
+   dictIndexCallback callback, void *arg )
+{
+   char          key[BUFFERSIZE];
+   char          buffer[BUFFERSIZE];
+   char          lineKey[BUFFERSIZE];
+   int           keyLength, len;
+   int           prefix = strategy == DICT_STRAT_PREFIX;
+   unsigned long count  = 0;
+   const char    *lo, *hi, *pt;
+   dictWord      dw;
+   dictFuzzy     fuzzy;
+
+   if (!index || !word)
+      return 0;
+   if ((strategy < DICT_STRAT_EXACT || strategy > DICT_STRAT_SUFFIX)
+       && strategy != DICT_STRAT_LEVENSHTEIN)
+      err_internal( __func__, "Unsupported strategy %d\n", strategy );
+
+   keyLength = dict_index_normalize( index, word, (int) strlen( word ),
+				     key, sizeof( key ) );
+   if (index->bin) {
+      count = dict_bin_enumerate( index, key, keyLength, strategy, distance,
+				  max, callback, arg );
+      PRINTF(DBG_SEARCH,("%s: %lu match(es) for \"%s\" (compiled)\n",
+			 __func__, count, word));
+      return count;
+   }
+
+				/* Only compiled indexes have a suffix
+                                   array and a trie; a text index is
+                                   scanned. */
+   if (strategy == DICT_STRAT_SUBSTRING || strategy == DICT_STRAT_SUFFIX
+       || strategy == DICT_STRAT_LEVENSHTEIN)
+   {
+      if (strategy == DICT_STRAT_LEVENSHTEIN
+	  && !dict_fuzzy_init( &fuzzy, index, key, keyLength, distance ))
+	 return 0;
+      for (pt = index->start; pt < index->end && count < max;
+	   pt = dict_index_next_line( index, pt ))
+      {
+	 len = dict_index_key( index, pt, lineKey, sizeof( lineKey ) );
+	 if (!dict_index_match_key( key, keyLength, lineKey, len,
+				    strategy, &fuzzy ))
+	    continue;
+	 dict_index_fill( index, pt, &dw, buffer );
+	 ++count;
+	 if (callback( &dw, arg ))
+	    break;
+      }
+      if (strategy == DICT_STRAT_LEVENSHTEIN)
+	 dict_fuzzy_free( &fuzzy );
+      PRINTF(DBG_SEARCH,("%s: %lu match(es) for \"%s\"\n",
+			 __func__, count, word));
+      return count;
+   }
+
+   if (keyLength) {
+      lo = index->optStart[(unsigned char) key[0]];
+      hi = index->optStart[(unsigned char) key[0] + 1];
+   } else {
+      lo = index->start;
+      hi = index->end;
+   }
+
+   pt = dict_index_lower_bound( index, key, keyLength, lo, hi, prefix );
+   for (; pt < hi && count < max; pt = dict_index_next_line( index, pt )) {
+      if (dict_index_compare( index, key, keyLength, pt, prefix ))
+	 break;
+      dict_index_fill( index, pt, &dw, buffer );
+      ++count;
+      if (callback( &dw, arg ))
+	 break;
+   }
+
+   PRINTF(DBG_SEARCH,("%s: %lu match(es) for \"%s\"\n",
+		      __func__, count, word));
+   return count;
+}
+
+unsigned long dict_index_enumerate(
+   const dictIndex *index,
+   const char *word, int strategy, unsigned long max,
+   dictIndexCallback callback, void *arg )
+{
+   return dict_index_walk( index, word, strategy, DICT_LEVENSHTEIN_DISTANCE,
+			   max, callback, arg );
+}
+
+unsigned long dict_index_fuzzy(
+   const dictIndex *index,
+   const char *word, int distance, unsigned long max,
+   dictIndexCallback callback, void *arg )
+{
+   return dict_index_walk( index, word, DICT_STRAT_LEVENSHTEIN, distance,
+			   max, callback, arg );
+}
+
+typedef struct dictSearchState {
+   dictWord *results;
+   int      count;
+} dictSearchState;
+
+static int dict_search_collect( const dictWord *dw, void *arg )
+{
+   dictSearchState *state = arg;
+   dictWord        *result = &state->results[state->count++];
+
+   *result      = *dw;
+   result->word = strcpy( xmalloc( strlen( dw->word ) + 1 ), dw->word );
+   return 0;
+}
+
+int dict_index_may_contain( const dictIndex *index, const char *word )
+{
+   char key[BUFFERSIZE];
+   int  len;
+
+   if (!index->bin || !index->bin->bloom)
+      return 1;
+   len = dict_index_normalize( index, word, (int) strlen( word ),
+			       key, sizeof( key ) );
+   return dict_bloom_contains( index->bin->bloom, key, len );
+}
+
+int dict_search_index(
+   const dictIndex *index,
+   const char *word, int strategy,
+   dictWord *results, int max )
+{
+   dictSearchState state;
+
+   state.results = results;
+   state.count   = 0;
+   if (max > 0)
+      dict_index_enumerate( index, word, strategy, max,
+			    dict_search_collect, &state );
+   return state.count;
+}
+
+void dict_destroy_results( dictWord *results, int count )
+{
+   int i;
+
+   for (i = 0; i < count; i++) {
+      if (results[i].word)
+	 xfree( results[i].word );
+      results[i].word = NULL;
+   }
+}
+
+int dict_index_compile( const char *filename )
+{
+   dictIndex      *index;
+   dictIndexEntry *entries;
+   dictWord       dw;
+   const char     *pt;
+   char           key[BUFFERSIZE];
+   char           word[BUFFERSIZE];
+   char           *binFilename;
+   unsigned long  i;
+   int            sorted = 1;
+   int            ret;
+
+   index = xmalloc( sizeof( dictIndex ) );
+   memset( index, 0, sizeof( dictIndex ) );
+   index->fd    = -1;
+   index->start = dict_index_map_file( filename, &index->fd, &index->size );
+   index->end   = index->start + index->size;
+   dict_index_scan( index );
+
+   entries = xmalloc( sizeof( dictIndexEntry ) * (index->headwords + 1) );
+   for (i = 0, pt = index->start; pt < index->end;
+	pt = dict_index_next_line( index, pt ), i++)
+   {
+      dict_index_key( index, pt, key, sizeof( key ) );
+      dict_index_fill( index, pt, &dw, word );
+      entries[i].word  = strcpy( xmalloc( strlen( word ) + 1 ), word );
+      entries[i].key   = strcpy( xmalloc( strlen( key ) + 1 ), key );
+      entries[i].start = dw.start;
+      entries[i].size  = dw.end;
+      entries[i].order = i;
+      if (i && strcmp( entries[i - 1].key, key ) > 0)
+	 sorted = 0;
+   }
+   if (!sorted) {
+      err_warning( __func__, "%s is not sorted, sorting\n", filename );
+      qsort( entries, index->headwords, sizeof( dictIndexEntry ),
+	     dict_index_entry_compare );
+   }
+
+   binFilename = xmalloc( strlen( filename ) + sizeof( DICT_BIN_SUFFIX ) );
+   strcpy( binFilename, filename );
+   strcat( binFilename, DICT_BIN_SUFFIX );
+   ret = dict_bin_write( binFilename, filename, index,
+			 entries, index->headwords );
+
+   for (i = 0; i < index->headwords; i++) {
+      xfree( (char *) entries[i].word );
+      xfree( (char *) entries[i].key );
+   }
+   xfree( entries );
+   xfree( binFilename );
+   dict_index_close( index );
+   return ret;
+}
@@ -0,0 +1,120 @@
+/* index.h -- Lookups in dictd .index files
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _INDEX_H_
+#define _INDEX_H_
+
+#include "defs.h"
+
+				/* Search strategies, numbered as in dictd */
+#define DICT_STRAT_EXACT        1
+#define DICT_STRAT_PREFIX       2
+#define DICT_STRAT_SUBSTRING    3
+#define DICT_STRAT_SUFFIX       4
+#define DICT_STRAT_LEVENSHTEIN  8
+
+				/* edit distance of DICT_STRAT_LEVENSHTEIN,
+                                   as in dictd */
+#define DICT_LEVENSHTEIN_DISTANCE 1
+
+struct dictFuzzy;
+
+/* map a .index file and compute its flags, optStart and headword count */
+extern dictIndex *dict_index_open (
+   const char *filename );
+extern void dict_index_close (
+   dictIndex *index );
+
+/* Compile the .index |filename| into the sidecar "|filename|.bin" that
+   dict_index_open() prefers while the size and mtime it records match
+   the .index exactly.  Returns 0 on success. */
+extern int dict_index_compile (
+   const char *filename );
+
+/* Map a whole file read-only, or read it into memory where mapping is
+   not available.  An empty file maps to "". */
+extern const char *dict_index_map_file (
+   const char *filename, int *fd, unsigned long *size );
+extern void dict_index_unmap_file (
+   const char *start, unsigned long size, int fd );
+
+/* Set the flag of |index| that the headword |headword| of |len| bytes
+   announces, if it is one of the 00-database-* entries. */
+extern void dict_index_check_flag (
+   dictIndex *index, const char *headword, int len );
+
+/* pick the character class table for the flags already set in |index| */
+extern void dict_index_set_flags (
+   dictIndex *index );
+
+/* Normalize |len| bytes of |src| into |dest| the way the index is
+   collated and return the length of the result, which is always
+   NUL-terminated within |size| bytes. */
+extern int dict_index_normalize (
+   const dictIndex *index,
+   const char *src, int len,
+   char *dest, int size );
+
+/* Whether |word| can be in |index|.  A 0 is certain, and costs a single
+   probe of the sidecar's filter; indexes without one always say 1.
+   Searches over many databases use it to skip those lacking the word. */
+extern int dict_index_may_contain (
+   const dictIndex *index, const char *word );
+
+/* Store up to |max| headwords matching |word| under |strategy| in
+   |results| and return how many were found.  As in dictd, the |end| of
+   each dictWord holds the size of the definition, so it can be passed to
+   dict_data_read_() unchanged. */
+extern int dict_search_index (
+   const dictIndex *index,
+   const char *word, int strategy,
+   dictWord *results, int max );
+
+/* Whether the normalized headword |word| of |len| bytes matches the
+   normalized |key| under DICT_STRAT_SUBSTRING, DICT_STRAT_SUFFIX or,
+   with |fuzzy| prepared for |key|, DICT_STRAT_LEVENSHTEIN.  This is the
+   linear fallback when there is no suffix array or trie. */
+extern int dict_index_match_key (
+   const char *key, int keyLength,
+   const char *word, int len, int strategy, struct dictFuzzy *fuzzy );
+
+/* Called by dict_index_enumerate() for each match.  |dw| and its
+   headword only live until the callback returns.  A nonzero return
+   ends the enumeration. */
+typedef int (*dictIndexCallback)( const dictWord *dw, void *arg );
+
+/* Hand the matches for |word| under |strategy| to |callback| in index
+   order, at most |max| of them, without collecting them first.  Returns
+   how many were passed on. */
+extern unsigned long dict_index_enumerate (
+   const dictIndex *index,
+   const char *word, int strategy, unsigned long max,
+   dictIndexCallback callback, void *arg );
+
+/* dict_index_enumerate() for the headwords within |distance| edits of
+   |word|.  Compiled indexes walk their trie and skip every subtree that
+   can no longer come close enough. */
+extern unsigned long dict_index_fuzzy (
+   const dictIndex *index,
+   const char *word, int distance, unsigned long max,
+   dictIndexCallback callback, void *arg );
+
+/* free the headword copies made by dict_search_index() */
+extern void dict_destroy_results (
+   dictWord *results, int count );
+
+#endif /* _INDEX_H_ */
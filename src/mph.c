@@ -0,0 +1,265 @@
+/* mph.c -- Minimal perfect hash over normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "mph.h"
+
+#define DICT_MPH_MASK     0xffffffffUL
+#define DICT_MPH_EMPTY    ((unsigned long) -1)
+#define DICT_MPH_LAMBDA   4	/* average keys per bucket */
+#define DICT_MPH_ATTEMPTS 8	/* global seeds to try */
+
+/* All arithmetic is done modulo 2^32 so that a section built where
+   unsigned long is 64 bits reads the same where it is 32. */
+
+static unsigned long dict_mph_mix( unsigned long h )
+{
+   h &= DICT_MPH_MASK;
+   h ^= h >> 16;
+   h  = (h * 0x85ebca6bUL) & DICT_MPH_MASK;
+   h ^= h >> 13;
+   h  = (h * 0xc2b2ae35UL) & DICT_MPH_MASK;
+   h ^= h >> 16;
+   return h;
+}
+
+/* h[0] picks the bucket, h[1] and h[2] the slot for a displacement */
+static void dict_mph_hash(
+   const char *key, int len, unsigned long seed, unsigned long *h )
+{
+   unsigned long a = (2166136261UL ^ seed) & DICT_MPH_MASK;
+   unsigned long b = (seed * 0x9e3779b1UL + (unsigned long) len)
+		     & DICT_MPH_MASK;
+   unsigned long c;
+   int           i;
+
+   for (i = 0; i < len; i++) {
+      c = (unsigned char) key[i];
+      a = ((a ^ c) * 16777619UL) & DICT_MPH_MASK;
+      b = ((((b << 5) | (b >> 27)) ^ c) * 0x27d4eb2dUL) & DICT_MPH_MASK;
+   }
+   h[0] = dict_mph_mix( a ^ 0x5bd1e995UL );
+   h[1] = dict_mph_mix( b );
+   h[2] = dict_mph_mix( a + b ) | 1;
+}
+
+static unsigned long dict_mph_slot(
+   const unsigned long *h, unsigned long d, unsigned long n )
+{
+   return dict_mph_mix( h[1] + d * h[2] ) % n;
+}
+
+/* Find a displacement for every bucket, biggest buckets first, so that
+   the |n| keys land on distinct slots.  Returns 0 if some bucket could
+   not be placed. */
+static int dict_mph_place(
+   unsigned long n, unsigned long buckets, const unsigned long *hashes,
+   unsigned long *displacement, unsigned long *slotKey )
+{
+   unsigned long *bucketStart;
+   unsigned long *members;
+   unsigned long *order;
+   unsigned long *sizeStart;
+   unsigned long slots[64];
+   unsigned long maxSize = 0;
+   unsigned long limit   = 16 * n + 1024;
+   unsigned long i, j, k, b, d, size;
+   int           ok      = 1;
+
+   bucketStart = xmalloc( (buckets + 1) * sizeof( unsigned long ) );
+   members     = xmalloc( n * sizeof( unsigned long ) );
+   order       = xmalloc( buckets * sizeof( unsigned long ) );
+   memset( bucketStart, 0, (buckets + 1) * sizeof( unsigned long ) );
+   for (i = 0; i < n; i++)
+      ++bucketStart[hashes[3 * i] % buckets + 1];
+   for (b = 0; b < buckets; b++) {
+      if (bucketStart[b + 1] > maxSize)
+	 maxSize = bucketStart[b + 1];
+      bucketStart[b + 1] += bucketStart[b];
+   }
+   if (maxSize > sizeof( slots ) / sizeof( slots[0] )) {
+      ok = 0;
+      goto done;
+   }
+   for (i = 0; i < n; i++)
+      members[bucketStart[hashes[3 * i] % buckets]++] = i;
+   for (b = buckets; b > 0; b--)	/* undo the increments */
+      bucketStart[b] = bucketStart[b - 1];
+   bucketStart[0] = 0;
+
+				/* counting sort of the buckets by
+                                   decreasing size */
+   sizeStart = xmalloc( (maxSize + 2) * sizeof( unsigned long ) );
+   memset( sizeStart, 0, (maxSize + 2) * sizeof( unsigned long ) );
+   for (b = 0; b < buckets; b++)
+      ++sizeStart[maxSize - (bucketStart[b + 1] - bucketStart[b]) + 1];
+   for (k = 0; k <= maxSize; k++)
+      sizeStart[k + 1] += sizeStart[k];
+   for (b = 0; b < buckets; b++)
+      order[sizeStart[maxSize - (bucketStart[b + 1] - bucketStart[b])]++]
+	 = b;
+   xfree( sizeStart );
+
+   for (i = 0; i < n; i++)
+      slotKey[i] = DICT_MPH_EMPTY;
+
+   for (k = 0; k < buckets; k++) {
+      b    = order[k];
+      size = bucketStart[b + 1] - bucketStart[b];
+      if (!size)
+	 break;			/* the rest are empty too */
+      for (d = 0; d < limit; d++) {
+	 for (j = 0; j < size; j++) {
+	    slots[j] = dict_mph_slot( hashes + 3 * members[bucketStart[b] + j],
+				      d, n );
+	    if (slotKey[slots[j]] != DICT_MPH_EMPTY)
+	       break;
+	    for (i = 0; i < j && slots[i] != slots[j]; i++)
+	       ;
+	    if (i < j)
+	       break;
+	 }
+	 if (j == size)
+	    break;
+      }
+      if (d == limit) {
+	 ok = 0;
+	 goto done;
+      }
+      displacement[b] = d;
+      for (j = 0; j < size; j++)
+	 slotKey[slots[j]] = members[bucketStart[b] + j];
+   }
+   for (; k < buckets; k++)
+      displacement[order[k]] = 0;
+
+ done:
+   xfree( order );
+   xfree( members );
+   xfree( bucketStart );
+   return ok;
+}
+
+unsigned char *dict_mph_build(
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length )
+{
+   unsigned long *first;
+   unsigned long *hashes;
+   unsigned long *displacement;
+   unsigned long *slotKey;
+   unsigned long n = 0, buckets, seed = 0;
+   unsigned long i, k, next;
+   unsigned char *section = NULL;
+   unsigned char *pt;
+   int           attempt;
+
+   first = xmalloc( (count + 1) * sizeof( unsigned long ) );
+   for (i = 0; i < count; i++)
+      if (!i || strcmp( entries[i - 1].key, entries[i].key ))
+	 first[n++] = i;
+   first[n] = count;
+
+   buckets      = n ? (n + DICT_MPH_LAMBDA - 1) / DICT_MPH_LAMBDA : 0;
+   hashes       = xmalloc( (3 * n + 1) * sizeof( unsigned long ) );
+   displacement = xmalloc( (buckets + 1) * sizeof( unsigned long ) );
+   slotKey      = xmalloc( (n + 1) * sizeof( unsigned long ) );
+
+   for (attempt = 0; attempt < DICT_MPH_ATTEMPTS; attempt++) {
+      seed = dict_mph_mix( 0x2545f491UL * (attempt + 1) );
+      for (k = 0; k < n; k++) {
+	 const char *key = entries[first[k]].key;
+
+	 dict_mph_hash( key, (int) strlen( key ), seed, hashes + 3 * k );
+      }
+      if (!n || dict_mph_place( n, buckets, hashes, displacement, slotKey ))
+	 break;
+      PRINTF(DBG_INIT,("%s: seed %lu failed\n", __func__, seed));
+   }
+   if (attempt == DICT_MPH_ATTEMPTS) {
+      err_warning( __func__, "No perfect hash for %lu keys\n", n );
+      goto done;
+   }
+
+   *length = DICT_MPH_HEADER_SIZE + 4 * buckets + DICT_MPH_SLOT_SIZE * n;
+   section = xmalloc( *length + 1 );
+   dict_bin_put_u32( section,     n );
+   dict_bin_put_u32( section + 4, buckets );
+   dict_bin_put_u32( section + 8, seed );
+   pt = section + DICT_MPH_HEADER_SIZE;
+   for (i = 0; i < buckets; i++, pt += 4)
+      dict_bin_put_u32( pt, displacement[i] );
+   for (i = 0; i < n; i++, pt += DICT_MPH_SLOT_SIZE) {
+      k = slotKey[i];
+      dict_bin_put_u32( pt,     first[k] );
+      dict_bin_put_u32( pt + 4, first[k + 1] - first[k] );
+   }
+
+				/* Check every key against the section
+                                   exactly as a lookup will see it. */
+   for (k = 0; k < n; k++) {
+      const char *key = entries[first[k]].key;
+
+      if (!dict_mph_lookup( section, key, (int) strlen( key ), &i, &next )
+	  || i != first[k] || next != first[k + 1] - first[k])
+	 err_internal( __func__, "Perfect hash misplaces \"%s\"\n",
+		       entries[first[k]].word );
+   }
+
+ done:
+   xfree( slotKey );
+   xfree( displacement );
+   xfree( hashes );
+   xfree( first );
+   return section;
+}
+
+int dict_mph_valid(
+   const unsigned char *mph, unsigned long length, unsigned long headwords )
+{
+   unsigned long n, buckets;
+
+   if (length < DICT_MPH_HEADER_SIZE)
+      return 0;
+   n       = dict_bin_u32( mph );
+   buckets = dict_bin_u32( mph + 4 );
+   return n <= headwords && (!n || buckets)
+      && buckets <= n
+      && length == DICT_MPH_HEADER_SIZE + 4 * buckets
+		   + DICT_MPH_SLOT_SIZE * n;
+}
+
+int dict_mph_lookup(
+   const unsigned char *mph,
+   const char *key, int keyLength,
+   unsigned long *first, unsigned long *count )
+{
+   unsigned long n       = dict_bin_u32( mph );
+   unsigned long buckets = dict_bin_u32( mph + 4 );
+   unsigned long h[3], d;
+   const unsigned char *slot;
+
+   if (!n)
+      return 0;
+   dict_mph_hash( key, keyLength, dict_bin_u32( mph + 8 ), h );
+   d    = dict_bin_u32( mph + DICT_MPH_HEADER_SIZE + 4 * (h[0] % buckets) );
+   slot = mph + DICT_MPH_HEADER_SIZE + 4 * buckets
+	  + DICT_MPH_SLOT_SIZE * dict_mph_slot( h, d, n );
+   *first = dict_bin_u32( slot );
+   *count = dict_bin_u32( slot + 4 );
+   return 1;
+}
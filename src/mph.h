@@ -0,0 +1,57 @@
+/* mph.h -- Minimal perfect hash over normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _MPH_H_
+#define _MPH_H_
+
+#include "binindex.h"
+
+/* The MPHF section of a sidecar maps every distinct normalized headword
+   to the run of records that carry it, in a constant number of memory
+   accesses (CHD-style hash and displace):
+
+      keys, buckets, seed
+      displacement[buckets]
+      { first record, record count }[keys]
+
+   A key hashes to a bucket, the bucket's displacement picks a slot, and
+   the slot names the records.  A word that is not in the index lands on
+   an arbitrary slot, so the caller has to compare it with the record. */
+
+#define DICT_MPH_HEADER_SIZE 12
+#define DICT_MPH_SLOT_SIZE   8
+
+/* Build the section for the |count| |entries|, which must be sorted by
+   key.  Every key is looked up again before the section is returned.
+   Returns NULL, with a warning, if no hash could be found. */
+extern unsigned char *dict_mph_build (
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length );
+
+/* check a mapped section against the sidecar's |headwords| */
+extern int dict_mph_valid (
+   const unsigned char *mph, unsigned long length,
+   unsigned long headwords );
+
+/* Store the candidate record run for |key| in |first| and |count|.
+   Returns 0 if the section is empty. */
+extern int dict_mph_lookup (
+   const unsigned char *mph,
+   const char *key, int keyLength,
+   unsigned long *first, unsigned long *count );
+
+#endif /* _MPH_H_ */
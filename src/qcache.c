@@ -0,0 +1,239 @@
+/* qcache.c -- Cache of query results above the chunk cache
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "qcache.h"
+
+static unsigned long dict_qcache_hash(
+   const char *database, const char *word, int strategy )
+{
+   unsigned long h = 2166136261UL;
+   const char    *pt;
+
+   for (pt = database; *pt; pt++)
+      h = ((h ^ (unsigned char) *pt) * 16777619UL) & 0xffffffffUL;
+   h = (h * 16777619UL) & 0xffffffffUL;
+   for (pt = word; *pt; pt++)
+      h = ((h ^ (unsigned char) *pt) * 16777619UL) & 0xffffffffUL;
+   h = ((h ^ (unsigned long) strategy) * 16777619UL) & 0xffffffffUL;
+   return h;
+}
+
+static dictQueryResult **dict_qcache_bucket(
+   dictQueryShard *shard, unsigned long hash )
+{
+   return &shard->buckets[(hash / DICT_QCACHE_SHARDS) % DICT_QCACHE_BUCKETS];
+}
+
+static int dict_qcache_match(
+   const dictQueryResult *r, unsigned long hash,
+   const char *database, const char *word, int strategy )
+{
+   return r->hash == hash && r->strategy == strategy
+      && !strcmp( r->word, word ) && !strcmp( r->database, database );
+}
+
+static void dict_qcache_free( dictQueryResult *r )
+{
+   if (r->words) xfree( r->words );
+   if (r->texts) xfree( r->texts );
+   xfree( r->blob );
+   xfree( r );
+}
+
+/* Take |r| out of its shard, freeing it unless someone holds it.
+   Called with the shard locked. */
+static void dict_qcache_unlink( dictQueryResult *r )
+{
+   dictQueryShard  *shard = r->shard;
+   dictQueryResult **pt;
+
+   for (pt = dict_qcache_bucket( shard, r->hash ); *pt != r;
+	pt = &(*pt)->next)
+      ;
+   *pt = r->next;
+   if (r->lruPrev) r->lruPrev->lruNext = r->lruNext;
+   else            shard->lruHead      = r->lruNext;
+   if (r->lruNext) r->lruNext->lruPrev = r->lruPrev;
+   else            shard->lruTail      = r->lruPrev;
+   shard->bytes -= r->size;
+   r->evicted    = 1;
+   if (!r->refs)
+      dict_qcache_free( r );
+}
+
+static void dict_qcache_push( dictQueryShard *shard, dictQueryResult *r )
+{
+   r->lruPrev = NULL;
+   r->lruNext = shard->lruHead;
+   if (shard->lruHead) shard->lruHead->lruPrev = r;
+   else                shard->lruTail          = r;
+   shard->lruHead = r;
+}
+
+dictQueryCache *dict_qcache_create( unsigned long maxBytes )
+{
+   dictQueryCache *cache = xmalloc( sizeof( dictQueryCache ) );
+   int            i;
+
+   memset( cache, 0, sizeof( dictQueryCache ) );
+   for (i = 0; i < DICT_QCACHE_SHARDS; i++) {
+      dict_mutex_init( &cache->shards[i].lock );
+      cache->shards[i].maxBytes = maxBytes / DICT_QCACHE_SHARDS;
+   }
+   return cache;
+}
+
+void dict_qcache_destroy( dictQueryCache *cache )
+{
+   int i;
+
+   if (!cache)
+      return;
+   for (i = 0; i < DICT_QCACHE_SHARDS; i++) {
+      while (cache->shards[i].lruHead)
+	 dict_qcache_unlink( cache->shards[i].lruHead );
+      dict_mutex_destroy( &cache->shards[i].lock );
+   }
+   xfree( cache );
+}
+
+dictQueryResult *dict_qcache_get(
+   dictQueryCache *cache,
+   const dictDatabase *db, const char *word, int strategy, int max )
+{
+   unsigned long   hash;
+   dictQueryShard  *shard;
+   dictQueryResult *r;
+
+   if (!cache || !db->databaseName || !db->data)
+      return NULL;
+   hash  = dict_qcache_hash( db->databaseName, word, strategy );
+   shard = &cache->shards[hash % DICT_QCACHE_SHARDS];
+
+   dict_mutex_lock( &shard->lock );
+   for (r = *dict_qcache_bucket( shard, hash ); r; r = r->next)
+      if (dict_qcache_match( r, hash, db->databaseName, word, strategy ))
+	 break;
+   if (r && (r->mtime != db->data->mtime || r->crc != db->data->crc)) {
+      PRINTF(DBG_UNZIP,("%s: %s changed, dropping %s\n",
+			__func__, db->databaseName, word));
+      dict_qcache_unlink( r );
+      r = NULL;
+   }
+   if (r && r->count >= r->max && r->max < max)
+      r = NULL;			/* cut short by a smaller limit */
+   if (r) {
+      if (r->lruPrev) r->lruPrev->lruNext = r->lruNext;
+      else            shard->lruHead      = r->lruNext;
+      if (r->lruNext) r->lruNext->lruPrev = r->lruPrev;
+      else            shard->lruTail      = r->lruPrev;
+      dict_qcache_push( shard, r );
+      ++r->refs;
+   }
+   dict_mutex_unlock( &shard->lock );
+   return r;
+}
+
+void dict_qcache_put(
+   dictQueryCache *cache,
+   const dictDatabase *db, const char *word, int strategy, int max,
+   const dictWord *words, char * const *texts, int count )
+{
+   dictQueryShard  *shard;
+   dictQueryResult *r;
+   dictQueryResult *old;
+   dictQueryResult **bucket;
+   unsigned long   hash, length;
+   char            *pt;
+   int             i;
+
+   if (!cache || !db->databaseName || !db->data)
+      return;
+   hash  = dict_qcache_hash( db->databaseName, word, strategy );
+   shard = &cache->shards[hash % DICT_QCACHE_SHARDS];
+
+   length = strlen( db->databaseName ) + strlen( word ) + 2;
+   for (i = 0; i < count; i++)
+      length += strlen( words[i].word ) + strlen( texts[i] ) + 2;
+   if (sizeof( dictQueryResult ) + length
+       + count * (sizeof( dictWord ) + sizeof( char * ))
+       > shard->maxBytes / 4)
+      return;
+
+   r = xmalloc( sizeof( dictQueryResult ) );
+   memset( r, 0, sizeof( dictQueryResult ) );
+   r->shard    = shard;
+   r->hash     = hash;
+   r->strategy = strategy;
+   r->max      = max;
+   r->mtime    = db->data->mtime;
+   r->crc      = db->data->crc;
+   r->count    = count;
+   r->size     = sizeof( dictQueryResult ) + length
+		 + count * (sizeof( dictWord ) + sizeof( char * ));
+   r->blob     = pt = xmalloc( length );
+   r->database = strcpy( pt, db->databaseName );
+   pt         += strlen( pt ) + 1;
+   r->word     = strcpy( pt, word );
+   pt         += strlen( pt ) + 1;
+   if (count) {
+      r->words = xmalloc( count * sizeof( dictWord ) );
+      r->texts = xmalloc( count * sizeof( char * ) );
+   }
+   for (i = 0; i < count; i++) {
+      r->words[i]      = words[i];
+      r->words[i].word = strcpy( pt, words[i].word );
+      pt              += strlen( pt ) + 1;
+      r->texts[i]      = strcpy( pt, texts[i] );
+      pt              += strlen( pt ) + 1;
+   }
+
+   dict_mutex_lock( &shard->lock );
+   bucket = dict_qcache_bucket( shard, hash );
+   for (old = *bucket; old; old = old->next)
+      if (dict_qcache_match( old, hash, db->databaseName, word, strategy )) {
+	 dict_qcache_unlink( old );	/* a concurrent miss got here first */
+	 break;
+      }
+   r->next = *bucket;
+   *bucket = r;
+   dict_qcache_push( shard, r );
+   shard->bytes += r->size;
+   while (shard->bytes > shard->maxBytes && shard->lruTail != r)
+      dict_qcache_unlink( shard->lruTail );
+   dict_mutex_unlock( &shard->lock );
+}
+
+void dict_qcache_retain( dictQueryResult *r )
+{
+   dict_mutex_lock( &r->shard->lock );
+   ++r->refs;
+   dict_mutex_unlock( &r->shard->lock );
+}
+
+void dict_qcache_release( dictQueryResult *r )
+{
+   dictQueryShard *shard = r->shard;
+   int            done;
+
+   dict_mutex_lock( &shard->lock );
+   done = !--r->refs && r->evicted;
+   dict_mutex_unlock( &shard->lock );
+   if (done)
+      dict_qcache_free( r );
+}
@@ -0,0 +1,100 @@
+/* qcache.h -- Cache of query results above the chunk cache
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _QCACHE_H_
+#define _QCACHE_H_
+
+#include "defs.h"
+#include "thread.h"
+
+/* The headwords and definition text one database returned for a word
+   under a strategy, keyed by database name, word and strategy.  Each
+   result is stamped with the mtime and CRC of the data file it was read
+   from; one that no longer matches the database is dropped on lookup,
+   so replacing a dictionary invalidates what was cached from it.
+   Misses are cached too: they are what most databases answer in a
+   search over many of them.
+
+   The cache is split into DICT_QCACHE_SHARDS shards, each with its own
+   lock and least-recently-used list, and holds at most the number of
+   bytes it was created with.  Results are reference counted, so one
+   can be evicted while a caller still sends it. */
+
+#define DICT_QCACHE_SHARDS  16
+#define DICT_QCACHE_BUCKETS 1024	/* hash chains per shard */
+
+typedef struct dictQueryResult {
+   struct dictQueryResult *next;	/* hash chain */
+   struct dictQueryResult *lruPrev;
+   struct dictQueryResult *lruNext;
+   struct dictQueryShard  *shard;
+   unsigned long          hash;
+   int                    refs;
+   int                    evicted;
+   unsigned long          size;		/* bytes charged to the shard */
+
+   char                   *blob;		/* every string below */
+   char                   *database;
+   char                   *word;
+   int                    strategy;
+   time_t                 mtime;
+   unsigned long          crc;
+
+   int                    max;		/* limit the search ran with */
+   int                    count;
+   dictWord               *words;	/* headwords point into the result */
+   char                   **texts;
+} dictQueryResult;
+
+typedef struct dictQueryShard {
+   dictMutex       lock;
+   dictQueryResult *buckets[DICT_QCACHE_BUCKETS];
+   dictQueryResult *lruHead;		/* most recently used */
+   dictQueryResult *lruTail;
+   unsigned long   bytes;
+   unsigned long   maxBytes;
+} dictQueryShard;
+
+typedef struct dictQueryCache {
+   dictQueryShard shards[DICT_QCACHE_SHARDS];
+} dictQueryCache;
+
+extern dictQueryCache *dict_qcache_create (
+   unsigned long maxBytes );
+extern void dict_qcache_destroy (
+   dictQueryCache *cache );
+
+/* The cached result for |word| under |strategy| in |db|, or NULL if
+   there is none or it may lack some of the first |max| matches.  A
+   result is held until dict_qcache_release(). */
+extern dictQueryResult *dict_qcache_get (
+   dictQueryCache *cache,
+   const dictDatabase *db, const char *word, int strategy, int max );
+
+/* Cache a copy of the |count| |words| and |texts| that a search limited
+   to |max| matches found for |word|. */
+extern void dict_qcache_put (
+   dictQueryCache *cache,
+   const dictDatabase *db, const char *word, int strategy, int max,
+   const dictWord *words, char * const *texts, int count );
+
+extern void dict_qcache_retain (
+   dictQueryResult *result );
+extern void dict_qcache_release (
+   dictQueryResult *result );
+
+#endif /* _QCACHE_H_ */
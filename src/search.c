@@ -0,0 +1,245 @@
+/* search.c -- Searches over several databases
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "data.h"
+#include "index.h"
+#include "search.h"
+
+#include <ctype.h>
+
+#define DICT_SEARCH_MAX_DEPTH 8	/* virtual databases within virtual ones */
+
+static int dict_search_expand(
+   dictDatabase **databases, int count,
+   const dictDatabase *db,
+   dictDatabase **members, int max, int n, int depth )
+{
+   const char *pt = db->database_list;
+   const char *end;
+   size_t     len;
+   int        i;
+
+   if (depth > DICT_SEARCH_MAX_DEPTH) {
+      err_warning( __func__, "Virtual database %s nests too deep\n",
+		   db->databaseName );
+      return n;
+   }
+
+   while (pt && *pt && n < max) {
+      if (!(end = strchr( pt, ',' )))
+	 end = pt + strlen( pt );
+      while (pt < end && isspace( (unsigned char) *pt ))
+	 ++pt;
+      for (len = end - pt;
+	   len && isspace( (unsigned char) pt[len - 1] );
+	   len--)
+	 ;
+
+      for (i = 0; i < count; i++)
+	 if (databases[i]->databaseName
+	     && strlen( databases[i]->databaseName ) == len
+	     && !memcmp( databases[i]->databaseName, pt, len ))
+	    break;
+      if (i == count) {
+	 if (len)
+	    err_warning( __func__, "Unknown database %.*s in %s\n",
+			 (int) len, pt, db->databaseName );
+      } else if (databases[i]->virtual_db)
+	 n = dict_search_expand( databases, count, databases[i],
+				 members, max, n, depth + 1 );
+      else
+	 members[n++] = databases[i];
+
+      pt = *end ? end + 1 : end;
+   }
+   return n;
+}
+
+int dict_search_members(
+   dictDatabase **databases, int count,
+   const dictDatabase *db,
+   dictDatabase **members, int max )
+{
+   return dict_search_expand( databases, count, db, members, max, 0, 0 );
+}
+
+typedef struct dictSearch dictSearch;
+
+/* the part of a search that looks at one database */
+typedef struct dictSearchTask {
+   dictTask        task;
+   dictSearch      *search;
+   dictDatabase    *database;
+   dictWord        *words;
+   char            **texts;
+   dictQueryResult *cached;
+   int             found;
+   int             done;
+} dictSearchTask;
+
+struct dictSearch {
+   dictQueryCache *cache;
+   const char     *word;
+   int            strategy;
+   int            max;
+   dictSearchTask *tasks;
+   int            count;
+   int            prefix;	/* tasks before this one are all done */
+   int            prefixFound;	/* and found this many definitions */
+   int            stop;
+   dictMutex      lock;
+   dictSemaphore  finished;
+};
+
+static void dict_search_task( void *arg )
+{
+   dictSearchTask *t  = arg;
+   dictSearch     *s  = t->search;
+   dictDatabase   *db = t->database;
+   int            stop, i;
+
+   dict_mutex_lock( &s->lock );
+   stop = s->stop;
+   dict_mutex_unlock( &s->lock );
+
+   if (stop || !db->index || !db->data)
+      goto done;
+
+   if ((t->cached = dict_qcache_get( s->cache, db, s->word,
+				     s->strategy, s->max )))
+      t->found = t->cached->count < s->max ? t->cached->count : s->max;
+   else if (s->strategy != DICT_STRAT_EXACT
+	    || dict_index_may_contain( db->index, s->word ))
+   {
+      t->words = xmalloc( s->max * sizeof( dictWord ) );
+      t->found = dict_search_index( db->index, s->word, s->strategy,
+				    t->words, s->max );
+      if (t->found) {
+	 t->texts = xmalloc( t->found * sizeof( char * ) );
+	 for (i = 0; i < t->found; i++)
+	    t->texts[i] = dict_data_obtain( db, &t->words[i] );
+      }
+      dict_qcache_put( s->cache, db, s->word, s->strategy, s->max,
+		       t->words, t->texts, t->found );
+   }
+
+ done:
+
+				/* Results are used in database order, so
+                                   only the databases before the first one
+                                   still running count towards the limit. */
+   dict_mutex_lock( &s->lock );
+   t->done = 1;
+   while (s->prefix < s->count && s->tasks[s->prefix].done)
+      s->prefixFound += s->tasks[s->prefix++].found;
+   if (s->prefixFound >= s->max)
+      s->stop = 1;
+   dict_mutex_unlock( &s->lock );
+   dict_semaphore_post( &s->finished );
+}
+
+int dict_search_databases(
+   dictPool *pool, dictQueryCache *cache,
+   dictDatabase **databases, int count,
+   const char *word, int strategy,
+   dictDefinition *results, int max )
+{
+   dictSearch     search;
+   dictSearchTask *t;
+   int            i, j, n = 0;
+
+   if (max <= 0 || count <= 0)
+      return 0;
+
+   memset( &search, 0, sizeof( search ) );
+   search.cache    = cache;
+   search.word     = word;
+   search.strategy = strategy;
+   search.max      = max;
+   search.count    = count;
+   search.tasks    = xmalloc( count * sizeof( dictSearchTask ) );
+   memset( search.tasks, 0, count * sizeof( dictSearchTask ) );
+   dict_mutex_init( &search.lock );
+   dict_semaphore_init( &search.finished, 0 );
+
+   for (i = 0; i < count; i++) {
+      t            = &search.tasks[i];
+      t->search    = &search;
+      t->database  = databases[i];
+      t->task.fn   = dict_search_task;
+      t->task.arg  = t;
+      if (pool)
+	 dict_pool_submit( pool, &t->task );
+      else
+	 dict_search_task( t );
+   }
+   for (i = 0; i < count; i++)
+      dict_semaphore_wait( &search.finished );
+
+   for (i = 0; i < count; i++) {
+      t = &search.tasks[i];
+      for (j = 0; j < t->found && t->cached && n < max; j++, n++) {
+	 results[n].database = t->database;
+	 results[n].dw       = t->cached->words[j];
+	 results[n].text     = t->cached->texts[j];
+	 results[n].cached   = t->cached;
+	 dict_qcache_retain( t->cached );
+      }
+      if (t->cached)
+	 dict_qcache_release( t->cached );
+      for (j = 0; j < t->found && !t->cached; j++) {
+	 if (n < max) {
+	    results[n].database = t->database;
+	    results[n].dw       = t->words[j];
+	    results[n].text     = t->texts[j];
+	    results[n].cached   = NULL;
+	    ++n;
+	 } else {
+	    dict_destroy_results( &t->words[j], 1 );
+	    if (t->texts[j])
+	       xfree( t->texts[j] );
+	 }
+      }
+      if (t->words)
+	 xfree( t->words );
+      if (t->texts)
+	 xfree( t->texts );
+   }
+
+   dict_semaphore_destroy( &search.finished );
+   dict_mutex_destroy( &search.lock );
+   xfree( search.tasks );
+   return n;
+}
+
+void dict_destroy_definitions( dictDefinition *results, int count )
+{
+   int i;
+
+   for (i = 0; i < count; i++) {
+      if (results[i].cached)
+	 dict_qcache_release( results[i].cached );
+      else {
+	 dict_destroy_results( &results[i].dw, 1 );
+	 if (results[i].text)
+	    xfree( results[i].text );
+      }
+      results[i].text   = NULL;
+      results[i].cached = NULL;
+   }
+}
@@ -0,0 +1,60 @@
+/* search.h -- Searches over several databases
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _SEARCH_H_
+#define _SEARCH_H_
+
+#include "defs.h"
+#include "thread.h"
+#include "qcache.h"
+
+/* A definition found by dict_search_databases(). */
+typedef struct dictDefinition {
+   const dictDatabase *database;
+   dictWord           dw;		/* with its own copy of the headword */
+   char               *text;		/* as dict_data_obtain() returns it */
+   dictQueryResult    *cached;		/* holding headword and text, if they
+					   came from the cache */
+} dictDefinition;
+
+/* Expand the members of the virtual database |db| into |members|,
+   looking their names up among the |count| |databases|.  Members that
+   are virtual themselves are expanded in turn.  Returns how many were
+   stored, at most |max|. */
+extern int dict_search_members (
+   dictDatabase **databases, int count,
+   const dictDatabase *db,
+   dictDatabase **members, int max );
+
+/* Search the |count| |databases| for |word| under |strategy| and read
+   the definitions, one task per database on |pool| (or one after the
+   other without a pool).  With a |cache|, databases that answered the
+   same query before are not searched again.  Results are stored in the order the databases
+   are given, at most |max| of them; DICT_DAEMON_LIMIT_DEFS is the usual
+   limit.  Databases are not started once those before them have found
+   |max| definitions, and exact searches skip the databases whose filter
+   rules the word out.  Returns how many definitions were stored. */
+extern int dict_search_databases (
+   dictPool *pool, dictQueryCache *cache,
+   dictDatabase **databases, int count,
+   const char *word, int strategy,
+   dictDefinition *results, int max );
+
+extern void dict_destroy_definitions (
+   dictDefinition *results, int count );
+
+#endif /* _SEARCH_H_ */
@@ -0,0 +1,532 @@
+/* serve.c -- Answer range and definition requests over a local socket
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "data.h"
+#include "index.h"
+#include "search.h"
+#include "serve.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET dictSocket;
+#define dict_socket_close closesocket
+#define dict_socket_error() ((int) WSAGetLastError())
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+typedef int dictSocket;
+#define INVALID_SOCKET    (-1)
+#define dict_socket_close close
+#define dict_socket_error() errno
+#endif
+
+#define DICT_SERVE_LINE    BUFFERSIZE	 /* longest request */
+#define DICT_SERVE_PENDING 64		 /* requests in flight per client */
+#define DICT_SERVE_CLIENTS (FD_SETSIZE - 1)
+#define DICT_SERVE_BACKLOG 16
+#define DICT_SERVE_CACHE   (16L << 20)	 /* bytes of cached definitions */
+
+typedef struct dictServer dictServer;
+typedef struct dictServeClient dictServeClient;
+
+typedef struct dictServeRequest {
+   dictTask                task;
+   dictServeClient         *client;
+   char                    *line;	/* NULL if it was too long */
+   char                    *response;	/* answered out of turn */
+   unsigned long           length;
+   int                     done;
+   struct dictServeRequest *next;
+} dictServeRequest;
+
+/* The event loop reads requests and queues them in order of arrival.
+   Workers answer them in any order, but only one of them at a time
+   writes, and only answers at the head of the queue: the request that
+   is first in line when its worker starts is streamed to the socket,
+   the others are kept until their turn. */
+struct dictServeClient {
+   dictServer       *server;
+   dictSocket       socket;
+   dictMutex        lock;		/* guards the queue and counters */
+   dictServeRequest *head;
+   dictServeRequest *tail;
+   int              pending;	/* requests queued */
+   int              sending;	/* a worker is writing answers */
+   int              broken;	/* a write failed, drop the rest */
+   int              refs;		/* the loop's and one per request */
+   char             input[DICT_SERVE_LINE];	/* loop only */
+   int              inputLength;
+};
+
+struct dictServer {
+   dictDatabase    **databases;
+   int             count;
+   dictPool        *pool;
+   dictQueryCache  *cache;
+};
+
+/* Where an answer goes: straight to the socket, or into |buffer|. */
+typedef struct dictServeReply {
+   dictServeClient *client;
+   int             direct;
+   char            *buffer;
+   unsigned long   length;
+   unsigned long   size;
+} dictServeReply;
+
+static void dict_serve_send(
+   dictServeClient *c, const char *pt, unsigned long len )
+{
+   int count;
+
+   while (len && !c->broken) {
+      count = send( c->socket, pt, len > 0x10000 ? 0x10000 : (int) len, 0 );
+      if (count <= 0) {
+#ifndef _WIN32
+	 if (count < 0 && errno == EINTR)
+	    continue;
+#endif
+	 c->broken = 1;
+	 break;
+      }
+      pt  += count;
+      len -= count;
+   }
+}
+
+/* Make room for |len| more bytes in a buffered reply. */
+static void dict_serve_reserve( dictServeReply *reply, unsigned long len )
+{
+   char *buffer;
+
+   if (reply->direct || reply->length + len <= reply->size)
+      return;
+   reply->size = 2 * reply->size > reply->length + len
+		 ? 2 * reply->size : reply->length + len;
+   buffer      = xmalloc( reply->size );
+   if (reply->buffer) {
+      memcpy( buffer, reply->buffer, reply->length );
+      xfree( reply->buffer );
+   }
+   reply->buffer = buffer;
+}
+
+static void dict_serve_write(
+   dictServeReply *reply, const char *pt, unsigned long len )
+{
+   if (reply->direct)
+      dict_serve_send( reply->client, pt, len );
+   else {
+      dict_serve_reserve( reply, len );
+      memcpy( reply->buffer + reply->length, pt, len );
+      reply->length += len;
+   }
+}
+
+static void dict_serve_error( dictServeReply *reply, const char *message )
+{
+   char line[DICT_SERVE_LINE + 32];
+
+   snprintf( line, sizeof( line ), "ERR %.*s\n",
+	     DICT_SERVE_LINE, message );
+   dict_serve_write( reply, line, strlen( line ) );
+}
+
+static dictDatabase *dict_serve_database( dictServer *s, const char *name )
+{
+   int i;
+
+   for (i = 0; i < s->count; i++)
+      if (!strcmp( s->databases[i]->databaseName, name ))
+	 return s->databases[i];
+   return NULL;
+}
+
+static void dict_serve_range(
+   dictServer *s, dictServeReply *reply, const char *args )
+{
+   char           name[DICT_SERVE_LINE];
+   char           line[64];
+   unsigned long  start, size;
+   dictDatabase   *db;
+   dictDataStream stream;
+   const char     *slice;
+   unsigned long  len;
+
+   if (sscanf( args, "%s %lu %lu", name, &start, &size ) != 3) {
+      dict_serve_error( reply, "usage: RANGE database start size" );
+      return;
+   }
+   if (!(db = dict_serve_database( s, name )) || !db->data) {
+      dict_serve_error( reply, "unknown database" );
+      return;
+   }
+
+   dict_data_stream_open( &stream, db->data, start, size, NULL, NULL );
+   snprintf( line, sizeof( line ), "OK %lu\n", stream.end - stream.pos );
+   dict_serve_write( reply, line, strlen( line ) );
+   dict_serve_reserve( reply, stream.end - stream.pos );
+   while (dict_data_stream_next( &stream, &slice, &len ))
+      dict_serve_write( reply, slice, len );
+   dict_data_stream_close( &stream );
+}
+
+static void dict_serve_define(
+   dictServer *s, dictServeReply *reply, const char *args )
+{
+   char           name[DICT_SERVE_LINE];
+   char           line[DICT_SERVE_LINE + 32];
+   const char     *word;
+   dictDatabase   *one;
+   dictDatabase   **databases = s->databases;
+   int            count       = s->count;
+   dictDefinition *results;
+   int            found, i;
+
+   if (sscanf( args, "%s", name ) != 1
+       || !*(word = args + strspn( args, " " ) + strlen( name ))
+       || !*(word += strspn( word, " " ))) {
+      dict_serve_error( reply, "usage: DEFINE database word" );
+      return;
+   }
+   if (strcmp( name, "*" )) {
+      if (!(one = dict_serve_database( s, name )) || !one->index) {
+	 dict_serve_error( reply, "unknown database" );
+	 return;
+      }
+      databases = &one;
+      count     = 1;
+   }
+
+				/* the pool is busy answering requests, so
+                                   the databases are searched in turn */
+   results = xmalloc( DICT_DAEMON_LIMIT_DEFS * sizeof( dictDefinition ) );
+   found   = dict_search_databases( NULL, s->cache, databases, count,
+				    word, DICT_STRAT_EXACT,
+				    results, DICT_DAEMON_LIMIT_DEFS );
+
+   snprintf( line, sizeof( line ), "OK %d\n", found );
+   dict_serve_write( reply, line, strlen( line ) );
+   for (i = 0; i < found; i++) {
+      snprintf( line, sizeof( line ), "%s %lu\n",
+		results[i].database->databaseName,
+		(unsigned long) strlen( results[i].text ) );
+      dict_serve_write( reply, line, strlen( line ) );
+      dict_serve_write( reply, results[i].text, strlen( results[i].text ) );
+   }
+
+   dict_destroy_definitions( results, found );
+   xfree( results );
+}
+
+static void dict_serve_answer(
+   dictServer *s, dictServeRequest *r, dictServeReply *reply )
+{
+   if (!r->line)
+      dict_serve_error( reply, "request too long" );
+   else if (!strncmp( r->line, "RANGE ", 6 ))
+      dict_serve_range( s, reply, r->line + 6 );
+   else if (!strncmp( r->line, "DEFINE ", 7 ))
+      dict_serve_define( s, reply, r->line + 7 );
+   else
+      dict_serve_error( reply, "unknown request" );
+}
+
+static void dict_serve_free( dictServeClient *c )
+{
+   dict_socket_close( c->socket );
+   dict_mutex_destroy( &c->lock );
+   xfree( c );
+}
+
+/* Write the answers at the head of the queue that are ready.  Called
+   with |c->lock| held and |c->sending| set, which it clears. */
+static void dict_serve_flush( dictServeClient *c )
+{
+   dictServeRequest *r;
+
+   while ((r = c->head) && r->done) {
+      if (!(c->head = r->next))
+	 c->tail = NULL;
+      --c->pending;
+      dict_mutex_unlock( &c->lock );
+
+      if (r->response) {
+	 dict_serve_send( c, r->response, r->length );
+	 xfree( r->response );
+      }
+      if (r->line)
+	 xfree( r->line );
+      xfree( r );
+
+      dict_mutex_lock( &c->lock );
+      --c->refs;
+   }
+   c->sending = 0;
+}
+
+static void dict_serve_request( void *arg )
+{
+   dictServeRequest *r = arg;
+   dictServeClient  *c = r->client;
+   dictServeReply   reply;
+   int              last;
+
+   memset( &reply, 0, sizeof( reply ) );
+   reply.client = c;
+
+   dict_mutex_lock( &c->lock );
+   if ((reply.direct = !c->sending && c->head == r))
+      c->sending = 1;
+   dict_mutex_unlock( &c->lock );
+
+   dict_serve_answer( c->server, r, &reply );
+   r->response = reply.buffer;
+   r->length   = reply.length;
+
+   dict_mutex_lock( &c->lock );
+   r->done = 1;
+   if (reply.direct || (!c->sending && c->head == r)) {
+      c->sending = 1;
+      dict_serve_flush( c );
+   }
+   last = !c->refs;
+   dict_mutex_unlock( &c->lock );
+
+   if (last)
+      dict_serve_free( c );
+}
+
+/* Queue the request in |line| (NULL if it was too long). */
+static void dict_serve_queue( dictServeClient *c, const char *line )
+{
+   dictServeRequest *r = xmalloc( sizeof( dictServeRequest ) );
+
+   memset( r, 0, sizeof( dictServeRequest ) );
+   r->client   = c;
+   r->task.fn  = dict_serve_request;
+   r->task.arg = r;
+   if (line) {
+      r->line = xmalloc( strlen( line ) + 1 );
+      strcpy( r->line, line );
+   }
+
+   dict_mutex_lock( &c->lock );
+   if (c->tail)
+      c->tail->next = r;
+   else
+      c->head = r;
+   c->tail = r;
+   ++c->pending;
+   ++c->refs;
+   dict_mutex_unlock( &c->lock );
+
+   dict_pool_submit( c->server->pool, &r->task );
+}
+
+/* Read what |c| sent and queue the complete lines.  Returns 0 once the
+   client is done sending. */
+static int dict_serve_read( dictServeClient *c )
+{
+   int  count;
+   char *line, *end, *pt;
+
+   count = recv( c->socket, c->input + c->inputLength,
+		 DICT_SERVE_LINE - c->inputLength, 0 );
+   if (count <= 0) {
+#ifndef _WIN32
+      if (count < 0 && errno == EINTR)
+	 return 1;
+#endif
+      return 0;
+   }
+   c->inputLength += count;
+
+   for (line = c->input;
+	(end = memchr( line, '\n', c->input + c->inputLength - line ));
+	line = end + 1)
+   {
+      *end = '\0';
+      if (end > line && end[-1] == '\r')
+	 end[-1] = '\0';
+      for (pt = line; *pt == ' ' || *pt == '\t'; pt++)
+	 ;
+      if (!*pt)
+	 continue;
+      if (!strcmp( pt, "QUIT" ))
+	 return 0;
+      dict_serve_queue( c, pt );
+   }
+
+   c->inputLength -= line - c->input;
+   memmove( c->input, line, c->inputLength );
+   if (c->inputLength == DICT_SERVE_LINE) {
+      dict_serve_queue( c, NULL );
+      return 0;
+   }
+   return 1;
+}
+
+/* Drop the loop's hold on |c|. */
+static void dict_serve_release( dictServeClient *c )
+{
+   int last;
+
+   dict_mutex_lock( &c->lock );
+   last = !--c->refs;
+   dict_mutex_unlock( &c->lock );
+
+   if (last)
+      dict_serve_free( c );
+}
+
+static dictSocket dict_serve_listen( const char *address )
+{
+   dictSocket         listener;
+#ifdef _WIN32
+   WSADATA            wsa;
+   struct sockaddr_in sa;
+
+   if (WSAStartup( MAKEWORD( 2, 2 ), &wsa ))
+      err_fatal( __func__, "Cannot initialize Winsock\n" );
+
+   memset( &sa, 0, sizeof( sa ) );
+   sa.sin_family      = AF_INET;
+   sa.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+   sa.sin_port        = htons( (unsigned short) atoi( address ) );
+   if ((listener = socket( AF_INET, SOCK_STREAM, 0 )) == INVALID_SOCKET)
+      return INVALID_SOCKET;
+#else
+   struct sockaddr_un sa;
+   struct stat        st;
+
+   if (strlen( address ) >= sizeof( sa.sun_path ))
+      err_fatal( __func__, "Socket name too long: %s\n", address );
+
+   memset( &sa, 0, sizeof( sa ) );
+   sa.sun_family = AF_UNIX;
+   strcpy( sa.sun_path, address );
+				/* a server that went away leaves its
+                                   socket behind */
+   if (!stat( address, &st ) && S_ISSOCK( st.st_mode ))
+      unlink( address );
+   if ((listener = socket( AF_UNIX, SOCK_STREAM, 0 )) == INVALID_SOCKET)
+      return INVALID_SOCKET;
+#endif
+
+   if (bind( listener, (struct sockaddr *) &sa, sizeof( sa ) )
+       || listen( listener, DICT_SERVE_BACKLOG )) {
+      dict_socket_close( listener );
+      return INVALID_SOCKET;
+   }
+   return listener;
+}
+
+int dict_serve(
+   const char *address,
+   dictDatabase **databases, int count, int threads )
+{
+   dictServer      server;
+   dictServeClient **clients;
+   dictServeClient *c;
+   dictSocket      listener, s, top;
+   fd_set          readable;
+   struct timeval  tv;
+   int             throttled;
+   int             n = 0;
+   int             i, j;
+
+   if ((listener = dict_serve_listen( address )) == INVALID_SOCKET) {
+      err_warning( __func__, "Cannot listen on %s (%d)\n",
+		   address, dict_socket_error() );
+      return -1;
+   }
+#ifndef _WIN32
+   signal( SIGPIPE, SIG_IGN );
+#endif
+
+   server.databases = databases;
+   server.count     = count;
+   server.pool      = dict_pool_create( threads > 0
+					? threads : dict_cpu_count() );
+   server.cache     = dict_qcache_create( DICT_SERVE_CACHE );
+   clients          = xmalloc( DICT_SERVE_CLIENTS * sizeof( *clients ) );
+
+   for (;;) {
+      FD_ZERO( &readable );
+      top       = listener;
+      throttled = 0;
+      if (n < DICT_SERVE_CLIENTS)
+	 FD_SET( listener, &readable );
+				/* clients with many answers outstanding
+                                   are not read until workers catch up */
+      for (i = 0; i < n; i++) {
+	 dict_mutex_lock( &clients[i]->lock );
+	 if (clients[i]->pending >= DICT_SERVE_PENDING)
+	    throttled = 1;
+	 else {
+	    FD_SET( clients[i]->socket, &readable );
+	    if (clients[i]->socket > top)
+	       top = clients[i]->socket;
+	 }
+	 dict_mutex_unlock( &clients[i]->lock );
+      }
+
+      tv.tv_sec  = 0;
+      tv.tv_usec = 10000;
+      if (select( (int) top + 1, &readable, NULL, NULL,
+		  throttled ? &tv : NULL ) < 0) {
+#ifndef _WIN32
+	 if (errno == EINTR)
+	    continue;
+#endif
+	 err_fatal( __func__, "select failed (%d)\n", dict_socket_error() );
+      }
+
+      for (i = j = 0; i < n; i++) {
+	 if (FD_ISSET( clients[i]->socket, &readable )
+	     && !dict_serve_read( clients[i] ))
+	    dict_serve_release( clients[i] );
+	 else
+	    clients[j++] = clients[i];
+      }
+      n = j;
+
+      if (FD_ISSET( listener, &readable )
+	  && (s = accept( listener, NULL, NULL )) != INVALID_SOCKET) {
+#ifndef _WIN32
+	 if (s >= FD_SETSIZE) {
+	    dict_socket_close( s );
+	    continue;
+	 }
+#endif
+	 c = xmalloc( sizeof( dictServeClient ) );
+	 memset( c, 0, sizeof( dictServeClient ) );
+	 c->server = &server;
+	 c->socket = s;
+	 c->refs   = 1;
+	 dict_mutex_init( &c->lock );
+	 clients[n++] = c;
+      }
+   }
+}
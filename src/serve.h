@@ -0,0 +1,46 @@
+/* serve.h -- Answer range and definition requests over a local socket
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _SERVE_H_
+#define _SERVE_H_
+
+#include "defs.h"
+
+/* dictzip --serve keeps data files open, with their chunk caches warm,
+   for clients on the same machine.  It listens on a UNIX domain socket
+   at |address|; on Win32, where the toolset has none, |address| is a
+   TCP port on the loopback interface.
+
+   A request is one line, and a client may send several before reading
+   any answer.  Answers come back in the order of the requests:
+
+      RANGE database start size    OK length, a newline and the text
+      DEFINE database word         OK count and a newline, then for each
+                                   definition the database, its length,
+                                   a newline and the text
+      QUIT                         close after the answers so far
+
+   DEFINE looks for exact matches; the database "*" stands for all of
+   them.  A request that fails is answered with ERR and a message.
+
+   Requests are answered by |threads| threads, or one per CPU if
+   |threads| is 0.  Returns only if the socket cannot be set up. */
+extern int dict_serve (
+   const char *address,
+   dictDatabase **databases, int count, int threads );
+
+#endif /* _SERVE_H_ */
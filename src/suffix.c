@@ -0,0 +1,195 @@
+/* suffix.c -- Suffix array over normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "suffix.h"
+
+/* Suffixes that are equal up to their NUL keep text order, so the
+   headwords in a run of equal suffixes are already ascending. */
+static int dict_sufa_compare( const void *a, const void *b )
+{
+   const char *x = *(const char * const *) a;
+   const char *y = *(const char * const *) b;
+   int        cmp;
+
+   if ((cmp = strcmp( x, y )))
+      return cmp;
+   return x < y ? -1 : x > y;
+}
+
+unsigned char *dict_sufa_build(
+   const dictIndex *index,
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length )
+{
+   unsigned long n = 0, suffixes = 0, textLength = 0;
+   unsigned long i, k;
+   unsigned long *first;
+   const char    **sa;
+   char          *text;
+   const char    *pt;
+   unsigned char *section;
+   unsigned char *out;
+
+   first = xmalloc( (count + 1) * sizeof( unsigned long ) );
+   for (i = 0; i < count; i++) {
+      if (i && !strcmp( entries[i - 1].key, entries[i].key ))
+	 continue;
+      first[n++] = i;
+      textLength += strlen( entries[i].key ) + 1;
+   }
+
+   text = xmalloc( textLength + 1 );
+   for (pt = text, k = 0; k < n; k++) {
+      strcpy( (char *) pt, entries[first[k]].key );
+      pt += strlen( pt ) + 1;
+   }
+   for (pt = text; pt < text + textLength; pt++)
+      if (*pt && !(index->flag_utf8 && (*pt & 0xc0) == 0x80))
+	 ++suffixes;
+
+   sa = xmalloc( (suffixes + 1) * sizeof( const char * ) );
+   for (i = 0, pt = text; pt < text + textLength; pt++)
+      if (*pt && !(index->flag_utf8 && (*pt & 0xc0) == 0x80))
+	 sa[i++] = pt;
+   qsort( sa, suffixes, sizeof( const char * ), dict_sufa_compare );
+
+   *length = DICT_SUFA_HEADER_SIZE + n * DICT_SUFA_KEY_SIZE
+	     + suffixes * 4 + textLength;
+   section = xmalloc( *length + 1 );
+   dict_bin_put_u32( section,     n );
+   dict_bin_put_u32( section + 4, suffixes );
+   dict_bin_put_u32( section + 8, textLength );
+   out = section + DICT_SUFA_HEADER_SIZE;
+   for (pt = text, k = 0; k < n; k++, out += DICT_SUFA_KEY_SIZE) {
+      dict_bin_put_u32( out,     pt - text );
+      dict_bin_put_u32( out + 4, first[k] );
+      pt += strlen( pt ) + 1;
+   }
+   for (i = 0; i < suffixes; i++, out += 4)
+      dict_bin_put_u32( out, sa[i] - text );
+   memcpy( out, text, textLength );
+
+   PRINTF(DBG_INIT,("%s: %lu suffixes of %lu headwords\n",
+		    __func__, suffixes, n));
+
+   xfree( sa );
+   xfree( text );
+   xfree( first );
+   return section;
+}
+
+int dict_sufa_valid(
+   const unsigned char *sa, unsigned long length, unsigned long headwords )
+{
+   unsigned long n, suffixes, textLength;
+
+   if (length < DICT_SUFA_HEADER_SIZE)
+      return 0;
+   n          = dict_bin_u32( sa );
+   suffixes   = dict_bin_u32( sa + 4 );
+   textLength = dict_bin_u32( sa + 8 );
+   return n <= headwords
+      && suffixes <= textLength
+      && (!textLength || !sa[length - 1])
+      && length == DICT_SUFA_HEADER_SIZE + n * DICT_SUFA_KEY_SIZE
+		   + suffixes * 4 + textLength;
+}
+
+static int dict_sufa_compare_key( const void *a, const void *b )
+{
+   unsigned long x = *(const unsigned long *) a;
+   unsigned long y = *(const unsigned long *) b;
+
+   return x < y ? -1 : x > y;
+}
+
+unsigned long dict_sufa_search(
+   const unsigned char *sa,
+   const char *key, int keyLength, int suffix,
+   unsigned long **keys )
+{
+   unsigned long       n          = dict_bin_u32( sa );
+   unsigned long       suffixes   = dict_bin_u32( sa + 4 );
+   unsigned long       textLength = dict_bin_u32( sa + 8 );
+   const unsigned char *table     = sa + DICT_SUFA_HEADER_SIZE;
+   const unsigned char *positions = table + n * DICT_SUFA_KEY_SIZE;
+   const char          *text      = (const char *) positions + 4 * suffixes;
+   size_t              len        = keyLength + (suffix ? 1 : 0);
+   unsigned long       lo, hi, l, h, m, pos, i, count;
+
+   *keys = NULL;
+				/* lower and upper bound of the run of
+                                   suffixes that start with (or equal)
+                                   the key */
+   for (l = 0, h = suffixes; l < h;) {
+      m   = l + (h - l) / 2;
+      pos = dict_bin_u32( positions + 4 * m );
+      if (pos < textLength && strncmp( text + pos, key, len ) < 0)
+	 l = m + 1;
+      else
+	 h = m;
+   }
+   lo = l;
+   for (h = suffixes; l < h;) {
+      m   = l + (h - l) / 2;
+      pos = dict_bin_u32( positions + 4 * m );
+      if (pos < textLength && strncmp( text + pos, key, len ) <= 0)
+	 l = m + 1;
+      else
+	 h = m;
+   }
+   hi = l;
+   if (lo >= hi)
+      return 0;
+
+   *keys = xmalloc( (hi - lo) * sizeof( unsigned long ) );
+   for (count = 0, i = lo; i < hi; i++) {
+      pos = dict_bin_u32( positions + 4 * i );
+      for (l = 0, h = n; l < h;) {	/* last key starting at or before pos */
+	 m = l + (h - l) / 2;
+	 if (dict_bin_u32( table + m * DICT_SUFA_KEY_SIZE ) <= pos)
+	    l = m + 1;
+	 else
+	    h = m;
+      }
+      if (l)
+	 (*keys)[count++] = l - 1;
+   }
+
+   qsort( *keys, count, sizeof( unsigned long ), dict_sufa_compare_key );
+   for (i = l = 0; i < count; i++)
+      if (!l || (*keys)[l - 1] != (*keys)[i])
+	 (*keys)[l++] = (*keys)[i];
+   return l;
+}
+
+void dict_sufa_records(
+   const unsigned char *sa, unsigned long headwords, unsigned long k,
+   unsigned long *lo, unsigned long *hi )
+{
+   unsigned long       n     = dict_bin_u32( sa );
+   const unsigned char *table = sa + DICT_SUFA_HEADER_SIZE;
+
+   *lo = dict_bin_u32( table + k * DICT_SUFA_KEY_SIZE + 4 );
+   *hi = k + 1 < n
+      ? dict_bin_u32( table + (k + 1) * DICT_SUFA_KEY_SIZE + 4 ) : headwords;
+   if (*hi > headwords)
+      *hi = headwords;
+   if (*lo > *hi)
+      *lo = *hi;
+}
@@ -0,0 +1,65 @@
+/* suffix.h -- Suffix array over normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _SUFFIX_H_
+#define _SUFFIX_H_
+
+#include "binindex.h"
+
+/* The SUFA section answers substring and suffix matches.  The distinct
+   normalized headwords are stored NUL-terminated one after another, and
+   every position in them where a match can start is sorted by the
+   suffix starting there:
+
+      keys, suffixes, text length
+      { text offset, first record }[keys]
+      text position[suffixes]
+      text
+
+   A substring match is then the run of suffixes that start with the
+   query, and a suffix match the run that equals it.  In UTF-8 indexes
+   suffixes never start inside a character. */
+
+#define DICT_SUFA_HEADER_SIZE 12
+#define DICT_SUFA_KEY_SIZE    8
+
+/* Build the section for the |count| |entries| of |index|, which must be
+   sorted by key. */
+extern unsigned char *dict_sufa_build (
+   const dictIndex *index,
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length );
+
+extern int dict_sufa_valid (
+   const unsigned char *sa, unsigned long length,
+   unsigned long headwords );
+
+/* Find the headwords that contain |key|, or with |suffix| set end with
+   it, and return how many there are.  Their numbers are stored in
+   ascending order, without duplicates, in |*keys|, which the caller
+   frees. */
+extern unsigned long dict_sufa_search (
+   const unsigned char *sa,
+   const char *key, int keyLength, int suffix,
+   unsigned long **keys );
+
+/* the records [|lo|, |hi|) carrying headword number |k| */
+extern void dict_sufa_records (
+   const unsigned char *sa, unsigned long headwords, unsigned long k,
+   unsigned long *lo, unsigned long *hi );
+
+#endif /* _SUFFIX_H_ */
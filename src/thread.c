@@ -0,0 +1,269 @@
+/* thread.c -- Minimal threading primitives for dictzip
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "defs.h"
+#include "thread.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#include <time.h>
+#endif
+
+typedef struct dictThreadStart {
+   dictThreadFunction fn;
+   void               *arg;
+} dictThreadStart;
+
+#ifdef _WIN32
+
+void dict_once( dictOnce *once, void (*fn)( void ) )
+{
+   if (*once == 2)
+      return;
+   if (InterlockedCompareExchange( once, 1, 0 ) == 0) {
+      fn();
+      InterlockedExchange( once, 2 );
+   } else {
+      while (*once != 2)
+	 Sleep( 0 );
+   }
+}
+
+void dict_mutex_init( dictMutex *m )    { InitializeCriticalSection( m ); }
+void dict_mutex_destroy( dictMutex *m ) { DeleteCriticalSection( m ); }
+void dict_mutex_lock( dictMutex *m )    { EnterCriticalSection( m ); }
+void dict_mutex_unlock( dictMutex *m )  { LeaveCriticalSection( m ); }
+
+void dict_semaphore_init( dictSemaphore *s, int count )
+{
+   if (!(*s = CreateSemaphore( NULL, count, LONG_MAX, NULL )))
+      err_fatal( __func__, "CreateSemaphore failed (%lu)\n",
+		 (unsigned long) GetLastError() );
+}
+
+void dict_semaphore_destroy( dictSemaphore *s )
+{
+   CloseHandle( *s );
+}
+
+void dict_semaphore_post( dictSemaphore *s )
+{
+   ReleaseSemaphore( *s, 1, NULL );
+}
+
+void dict_semaphore_wait( dictSemaphore *s )
+{
+   WaitForSingleObject( *s, INFINITE );
+}
+
+static unsigned __stdcall dict_thread_start( void *arg )
+{
+   dictThreadStart start = *(dictThreadStart *) arg;
+
+   xfree( arg );
+   start.fn( start.arg );
+   return 0;
+}
+
+void dict_thread_create( dictThread *t, dictThreadFunction fn, void *arg )
+{
+   dictThreadStart *start = xmalloc( sizeof( dictThreadStart ) );
+
+   start->fn  = fn;
+   start->arg = arg;
+   *t = (HANDLE) _beginthreadex( NULL, 0, dict_thread_start, start, 0, NULL );
+   if (!*t)
+      err_fatal_errno( __func__, "Cannot create thread\n" );
+}
+
+void dict_thread_join( dictThread t )
+{
+   WaitForSingleObject( t, INFINITE );
+   CloseHandle( t );
+}
+
+int dict_cpu_count( void )
+{
+   SYSTEM_INFO si;
+
+   GetSystemInfo( &si );
+   return si.dwNumberOfProcessors > 0 ? (int) si.dwNumberOfProcessors : 1;
+}
+
+double dict_seconds( void )
+{
+   static LARGE_INTEGER frequency;
+   LARGE_INTEGER        now;
+
+   if (!frequency.QuadPart)	/* the same on every processor */
+      QueryPerformanceFrequency( &frequency );
+   QueryPerformanceCounter( &now );
+   return (double) now.QuadPart / (double) frequency.QuadPart;
+}
+
+#else
+
+void dict_once( dictOnce *once, void (*fn)( void ) )
+{
+   pthread_once( once, fn );
+}
+
+void dict_mutex_init( dictMutex *m )    { pthread_mutex_init( m, NULL ); }
+void dict_mutex_destroy( dictMutex *m ) { pthread_mutex_destroy( m ); }
+void dict_mutex_lock( dictMutex *m )    { pthread_mutex_lock( m ); }
+void dict_mutex_unlock( dictMutex *m )  { pthread_mutex_unlock( m ); }
+
+void dict_semaphore_init( dictSemaphore *s, int count )
+{
+   pthread_mutex_init( &s->lock, NULL );
+   pthread_cond_init( &s->cond, NULL );
+   s->count = count;
+}
+
+void dict_semaphore_destroy( dictSemaphore *s )
+{
+   pthread_cond_destroy( &s->cond );
+   pthread_mutex_destroy( &s->lock );
+}
+
+void dict_semaphore_post( dictSemaphore *s )
+{
+   pthread_mutex_lock( &s->lock );
+   ++s->count;
+   pthread_cond_signal( &s->cond );
+   pthread_mutex_unlock( &s->lock );
+}
+
+void dict_semaphore_wait( dictSemaphore *s )
+{
+   pthread_mutex_lock( &s->lock );
+   while (s->count <= 0)
+      pthread_cond_wait( &s->cond, &s->lock );
+   --s->count;
+   pthread_mutex_unlock( &s->lock );
+}
+
+static void *dict_thread_start( void *arg )
+{
+   dictThreadStart start = *(dictThreadStart *) arg;
+
+   xfree( arg );
+   start.fn( start.arg );
+   return NULL;
+}
+
+void dict_thread_create( dictThread *t, dictThreadFunction fn, void *arg )
+{
+   dictThreadStart *start = xmalloc( sizeof( dictThreadStart ) );
+
+   start->fn  = fn;
+   start->arg = arg;
+   if ((errno = pthread_create( t, NULL, dict_thread_start, start )))
+      err_fatal_errno( __func__, "Cannot create thread\n" );
+}
+
+void dict_thread_join( dictThread t )
+{
+   pthread_join( t, NULL );
+}
+
+int dict_cpu_count( void )
+{
+#ifdef _SC_NPROCESSORS_ONLN
+   long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+   return n > 0 ? (int) n : 1;
+#else
+   return 1;
+#endif
+}
+
+double dict_seconds( void )
+{
+   struct timespec now;
+
+   clock_gettime( CLOCK_MONOTONIC, &now );
+   return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+#endif
+
+static void dict_pool_thread( void *arg )
+{
+   dictPool *pool = arg;
+   dictTask *task;
+
+   for (;;) {
+      dict_semaphore_wait( &pool->queued );
+      dict_mutex_lock( &pool->lock );
+      if ((task = pool->head) && !(pool->head = task->next))
+	 pool->tail = NULL;
+      dict_mutex_unlock( &pool->lock );
+      if (!task)
+	 break;
+      task->fn( task->arg );
+   }
+}
+
+dictPool *dict_pool_create( int threads )
+{
+   dictPool *pool = xmalloc( sizeof( dictPool ) );
+   int      i;
+
+   memset( pool, 0, sizeof( dictPool ) );
+   dict_mutex_init( &pool->lock );
+   dict_semaphore_init( &pool->queued, 0 );
+   pool->count   = threads > 0 ? threads : 1;
+   pool->threads = xmalloc( pool->count * sizeof( dictThread ) );
+   for (i = 0; i < pool->count; i++)
+      dict_thread_create( &pool->threads[i], dict_pool_thread, pool );
+   return pool;
+}
+
+void dict_pool_submit( dictPool *pool, dictTask *task )
+{
+   task->next = NULL;
+   dict_mutex_lock( &pool->lock );
+   if (pool->tail)
+      pool->tail->next = task;
+   else
+      pool->head = task;
+   pool->tail = task;
+   dict_mutex_unlock( &pool->lock );
+   dict_semaphore_post( &pool->queued );
+}
+
+void dict_pool_destroy( dictPool *pool )
+{
+   int i;
+
+				/* every task has a post of its own, so
+                                   these only wake threads to an empty
+                                   queue once the tasks are done */
+   for (i = 0; i < pool->count; i++)
+      dict_semaphore_post( &pool->queued );
+   for (i = 0; i < pool->count; i++)
+      dict_thread_join( pool->threads[i] );
+
+   dict_semaphore_destroy( &pool->queued );
+   dict_mutex_destroy( &pool->lock );
+   xfree( pool->threads );
+   xfree( pool );
+}
@@ -0,0 +1,99 @@
+/* thread.h -- Minimal threading primitives for dictzip
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+/* Only once-initialization, mutexes, counting semaphores and joinable
+   threads are provided.  Condition variables are deliberately left out:
+   the v110_xp toolset targets Windows XP, which has none. */
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+typedef CRITICAL_SECTION dictMutex;
+typedef HANDLE           dictSemaphore;
+typedef HANDLE           dictThread;
+typedef volatile LONG    dictOnce;
+#define DICT_ONCE_INIT   0
+#else
+#include <pthread.h>
+
+typedef pthread_mutex_t  dictMutex;
+typedef struct dictSemaphore {
+   pthread_mutex_t lock;
+   pthread_cond_t  cond;
+   int             count;
+} dictSemaphore;
+typedef pthread_t        dictThread;
+typedef pthread_once_t   dictOnce;
+#define DICT_ONCE_INIT   PTHREAD_ONCE_INIT
+#endif
+
+typedef void (*dictThreadFunction)( void *arg );
+
+/* run |fn| exactly once per |once|, however many threads get here */
+extern void dict_once( dictOnce *once, void (*fn)( void ) );
+
+extern void dict_mutex_init( dictMutex *m );
+extern void dict_mutex_destroy( dictMutex *m );
+extern void dict_mutex_lock( dictMutex *m );
+extern void dict_mutex_unlock( dictMutex *m );
+
+extern void dict_semaphore_init( dictSemaphore *s, int count );
+extern void dict_semaphore_destroy( dictSemaphore *s );
+extern void dict_semaphore_post( dictSemaphore *s );
+extern void dict_semaphore_wait( dictSemaphore *s );
+
+extern void dict_thread_create(
+   dictThread *t, dictThreadFunction fn, void *arg );
+extern void dict_thread_join( dictThread t );
+
+/* number of online processors, at least 1 */
+extern int  dict_cpu_count( void );
+
+/* seconds on a monotonic clock, for timing intervals */
+extern double dict_seconds( void );
+
+/* A task queued on a pool.  The caller owns it, and it must stay alive
+   until |fn| has been called. */
+typedef struct dictTask {
+   dictThreadFunction fn;
+   void               *arg;
+   struct dictTask    *next;
+} dictTask;
+
+/* A fixed set of threads running queued tasks in order of submission. */
+typedef struct dictPool {
+   dictMutex     lock;
+   dictSemaphore queued;	/* one post per task, and one per thread
+				   at shutdown */
+   dictTask      *head;
+   dictTask      *tail;
+   dictThread    *threads;
+   int           count;
+} dictPool;
+
+extern dictPool *dict_pool_create( int threads );
+extern void dict_pool_submit( dictPool *pool, dictTask *task );
+/* run the tasks still queued, then stop the threads */
+extern void dict_pool_destroy( dictPool *pool );
+
+#endif /* _THREAD_H_ */
@@ -0,0 +1,166 @@
+/* transform.c -- Reversible transforms of chunks before deflation
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "defs.h"
+#include "transform.h"
+#include "thread.h"
+
+int transform_mode = DICT_TRANSFORM_NONE;
+
+#define DICT_TOKEN_COUNT  27
+#define DICT_TOKEN_ESCAPE 0x1f	/* the next byte is literal */
+
+/* Never extend or reorder this table: files written with it depend on
+   the codes. */
+static const char *dictTokens[DICT_TOKEN_COUNT] = {
+   "\n   ",   "\n      ",
+   "<b>",     "</b>",     "<i>",     "</i>",
+   "<k>",     "</k>",     "<ex>",    "</ex>",
+   "<abr>",   "</abr>",   "<kref>",  "</kref>",
+   "<dtrn>",  "</dtrn>",  "<c>",     "</c>",
+   "<tr>",    "</tr>",    "<co>",    "</co>",
+   "[syn: {", "}, {",     "}]",
+   "adj. ",   "adv. "
+};
+
+/* Control bytes other than tab, newline and carriage return */
+static const unsigned char dictTokenCodes[DICT_TOKEN_COUNT] = {
+   0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+   0x0b, 0x0c, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+   0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b,
+   0x1c, 0x1d, 0x1e
+};
+
+static dictOnce      tokenOnce = DICT_ONCE_INIT;
+static int           tokenLength[DICT_TOKEN_COUNT];
+static signed char   tokenOf[256];	/* code -> token, or -1 */
+				/* tokens by first byte, longest first */
+static unsigned char tokenOrder[DICT_TOKEN_COUNT];
+static unsigned char tokenFirst[257];
+
+static void dict_token_init( void )
+{
+   int           i, j, n, t;
+   unsigned char swap;
+
+   memset( tokenOf, -1, sizeof( tokenOf ) );
+   for (i = 0; i < DICT_TOKEN_COUNT; i++) {
+      tokenLength[i]             = strlen( dictTokens[i] );
+      tokenOf[dictTokenCodes[i]] = i;
+   }
+
+   for (n = i = 0; i < 256; i++) {
+      tokenFirst[i] = n;
+      for (j = 0; j < DICT_TOKEN_COUNT; j++)
+	 if ((unsigned char) dictTokens[j][0] == i)
+	    tokenOrder[n++] = j;
+      for (j = tokenFirst[i] + 1; j < n; j++)
+	 for (t = j; t > tokenFirst[i]
+		 && tokenLength[tokenOrder[t]] > tokenLength[tokenOrder[t - 1]];
+	      t--) {
+	    swap              = tokenOrder[t];
+	    tokenOrder[t]     = tokenOrder[t - 1];
+	    tokenOrder[t - 1] = swap;
+	 }
+   }
+   tokenFirst[256] = n;
+}
+
+static int dict_token_encode(
+   const unsigned char *in, int len, unsigned char *out, int outMax )
+{
+   int i, o, k, t, n;
+
+   if (outMax > len - 1)
+      outMax = len - 1;		/* not worth it otherwise */
+
+   for (i = o = 0; i < len; i += n) {
+      for (k = tokenFirst[in[i]]; k < tokenFirst[in[i] + 1]; k++) {
+	 t = tokenOrder[k];
+	 if (tokenLength[t] <= len - i
+	     && !memcmp( in + i, dictTokens[t], tokenLength[t] ))
+	    break;
+      }
+      if (k < tokenFirst[in[i] + 1]) {
+	 if (o + 1 > outMax)
+	    return -1;
+	 out[o++] = dictTokenCodes[t];
+	 n        = tokenLength[t];
+      } else if (tokenOf[in[i]] >= 0 || in[i] == DICT_TOKEN_ESCAPE) {
+	 if (o + 2 > outMax)
+	    return -1;
+	 out[o++] = DICT_TOKEN_ESCAPE;
+	 out[o++] = in[i];
+	 n        = 1;
+      } else {
+	 if (o + 1 > outMax)
+	    return -1;
+	 out[o++] = in[i];
+	 n        = 1;
+      }
+   }
+   return o;
+}
+
+static int dict_token_decode(
+   const unsigned char *in, int len, unsigned char *out, int outLength )
+{
+   int i, o, t;
+
+   for (i = o = 0; i < len; i++) {
+      if (in[i] == DICT_TOKEN_ESCAPE) {
+	 if (++i >= len || o >= outLength)
+	    return -1;
+	 out[o++] = in[i];
+      } else if ((t = tokenOf[in[i]]) >= 0) {
+	 if (tokenLength[t] > outLength - o)
+	    return -1;
+	 memcpy( out + o, dictTokens[t], tokenLength[t] );
+	 o += tokenLength[t];
+      } else {
+	 if (o >= outLength)
+	    return -1;
+	 out[o++] = in[i];
+      }
+   }
+   return o == outLength ? 0 : -1;
+}
+
+int dict_transform_encode(
+   int transform, const char *in, int len, char *out, int outMax )
+{
+   switch (transform) {
+   case DICT_TRANSFORM_TOKENS:
+      dict_once( &tokenOnce, dict_token_init );
+      return dict_token_encode( (const unsigned char *) in, len,
+				(unsigned char *) out, outMax );
+   }
+   return -1;
+}
+
+int dict_transform_decode(
+   int transform, const char *in, int len, char *out, int outLength )
+{
+   switch (transform) {
+   case DICT_TRANSFORM_TOKENS:
+      dict_once( &tokenOnce, dict_token_init );
+      return dict_token_decode( (const unsigned char *) in, len,
+				(unsigned char *) out, outLength );
+   }
+   return -1;
+}
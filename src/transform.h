@@ -0,0 +1,55 @@
+/* transform.h -- Reversible transforms of chunks before deflation
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _TRANSFORM_H_
+#define _TRANSFORM_H_
+
+/* A transform rewrites each chunk of the text before it is deflated,
+   and is undone after the chunk is inflated.  Files written with one
+   carry version 2 of the random access subfield, which names the
+   transform after the chunk sizes, so dictzip readers that predate it
+   refuse them rather than return the rewritten text.  gzip and zcat
+   ignore the subfield and do return it: such files are no longer plain
+   gzip.
+
+   A chunk the transform does not shrink is stored as it is.  A reader
+   tells the two apart by length: only an untransformed chunk inflates
+   to the full length of its part of the text.
+
+   DICT_TRANSFORM_TOKENS replaces tokens from a fixed table (markup tags
+   of the common dictionary source formats, dictd's indentation and
+   cross-reference punctuation) with single control bytes.  Control
+   bytes already in the text are escaped. */
+
+#define DICT_TRANSFORM_NONE   0
+#define DICT_TRANSFORM_TOKENS 1
+
+/* Transform applied by dict_data_zip(), DICT_TRANSFORM_NONE by default */
+extern int transform_mode;
+
+/* Encode |len| bytes of |in| into |out|, which has room for |outMax|.
+   Returns the encoded length, or -1 if the result would not be shorter
+   than |len|. */
+extern int dict_transform_encode (
+   int transform, const char *in, int len, char *out, int outMax );
+
+/* Decode |len| bytes of |in| into |out|, which must come to exactly
+   |outLength| bytes.  Returns 0 on success, -1 if |in| is malformed. */
+extern int dict_transform_decode (
+   int transform, const char *in, int len, char *out, int outLength );
+
+#endif /* _TRANSFORM_H_ */
@@ -0,0 +1,248 @@
+/* trie.c -- Radix trie over normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include "dictzip.h"
+#include "trie.h"
+
+#define DICT_TRIE_CHILDREN(info) ((info) & 0x1ff)
+#define DICT_TRIE_BYTE(info)     (((info) >> 9) & 0xff)
+#define DICT_TRIE_LABEL(info)    ((info) >> 17)
+#define DICT_TRIE_MAX_LABEL      0x7fff
+
+unsigned char *dict_trie_build(
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length )
+{
+   unsigned long maxNodes = 2 * count + 1;
+   unsigned long *pending;	/* first entry, end, depth of each node */
+   unsigned long *lengths;
+   unsigned char *section;
+   unsigned char *nodes;
+   unsigned char *labels;
+   unsigned long labelLength = 0;
+   unsigned long nodeCount   = 1;
+   unsigned long i, r, g, a, b, depth, lcp, children;
+   const unsigned char *key;
+   int           c;
+
+   lengths = xmalloc( (count + 1) * sizeof( unsigned long ) );
+   for (r = 0; r < count; r++)
+      labelLength += lengths[r] = strlen( entries[r].key );
+
+   pending = xmalloc( 3 * maxNodes * sizeof( unsigned long ) );
+   nodes   = xmalloc( maxNodes * DICT_TRIE_NODE_SIZE );
+   labels  = xmalloc( labelLength + 1 );
+   labelLength = 0;
+
+   pending[0] = 0;
+   pending[1] = count;
+   pending[2] = 0;
+   memset( nodes, 0, DICT_TRIE_NODE_SIZE );
+
+   for (i = 0; i < nodeCount; i++) {
+      a     = pending[3 * i];
+      b     = pending[3 * i + 1];
+      depth = pending[3 * i + 2];
+
+				/* headwords ending here sort first */
+      for (r = a; r < b && lengths[r] == depth; r++)
+	 ;
+      dict_bin_put_u32( nodes + i * DICT_TRIE_NODE_SIZE + 4,
+			r < b ? nodeCount : 0 );
+
+      for (children = 0; r < b; children++, r = g) {
+	 key = (const unsigned char *) entries[r].key;
+	 c   = key[depth];
+	 for (g = r + 1;
+	      g < b && ((const unsigned char *) entries[g].key)[depth] == c;
+	      g++)
+	    ;
+				/* keys are sorted, so the first and last
+                                   of the group share what all share */
+	 for (lcp = depth + 1;
+	      lcp < lengths[r] && lcp < lengths[g - 1]
+		 && key[lcp] == (unsigned char) entries[g - 1].key[lcp]
+		 && lcp - depth < DICT_TRIE_MAX_LABEL;
+	      lcp++)
+	    ;
+	 if (nodeCount >= maxNodes)
+	    err_internal( __func__, "Too many nodes\n" );
+
+	 dict_bin_put_u32( nodes + nodeCount * DICT_TRIE_NODE_SIZE, r );
+	 dict_bin_put_u32( nodes + nodeCount * DICT_TRIE_NODE_SIZE + 4, 0 );
+	 dict_bin_put_u32( nodes + nodeCount * DICT_TRIE_NODE_SIZE + 8,
+			   labelLength );
+	 dict_bin_put_u32( nodes + nodeCount * DICT_TRIE_NODE_SIZE + 12,
+			   ((unsigned long) c << 9)
+			   | ((lcp - depth) << 17) );
+	 memcpy( labels + labelLength, key + depth, lcp - depth );
+	 labelLength += lcp - depth;
+
+	 pending[3 * nodeCount]     = r;
+	 pending[3 * nodeCount + 1] = g;
+	 pending[3 * nodeCount + 2] = lcp;
+	 ++nodeCount;
+      }
+      dict_bin_put_u32( nodes + i * DICT_TRIE_NODE_SIZE + 12,
+			dict_bin_u32( nodes + i * DICT_TRIE_NODE_SIZE + 12 )
+			| children );
+   }
+
+   *length = DICT_TRIE_HEADER_SIZE + nodeCount * DICT_TRIE_NODE_SIZE
+	     + labelLength;
+   section = xmalloc( *length + 1 );
+   dict_bin_put_u32( section,     nodeCount );
+   dict_bin_put_u32( section + 4, labelLength );
+   memcpy( section + DICT_TRIE_HEADER_SIZE,
+	   nodes, nodeCount * DICT_TRIE_NODE_SIZE );
+   memcpy( section + DICT_TRIE_HEADER_SIZE + nodeCount * DICT_TRIE_NODE_SIZE,
+	   labels, labelLength );
+
+   PRINTF(DBG_INIT,("%s: %lu nodes, %lu label bytes\n",
+		    __func__, nodeCount, labelLength));
+
+   xfree( labels );
+   xfree( nodes );
+   xfree( pending );
+   xfree( lengths );
+   return section;
+}
+
+int dict_trie_valid( const unsigned char *trie, unsigned long length )
+{
+   unsigned long nodeCount;
+
+   if (length < DICT_TRIE_HEADER_SIZE)
+      return 0;
+   nodeCount = dict_bin_u32( trie );
+   return nodeCount
+      && nodeCount <= (length - DICT_TRIE_HEADER_SIZE) / DICT_TRIE_NODE_SIZE
+      && length == DICT_TRIE_HEADER_SIZE + nodeCount * DICT_TRIE_NODE_SIZE
+		   + dict_bin_u32( trie + 4 );
+}
+
+int dict_trie_range(
+   const unsigned char *trie, unsigned long headwords,
+   const char *key, int keyLength,
+   unsigned long *lo, unsigned long *hi )
+{
+   unsigned long       nodeCount   = dict_bin_u32( trie );
+   unsigned long       labelLength = dict_bin_u32( trie + 4 );
+   const unsigned char *nodes      = trie + DICT_TRIE_HEADER_SIZE;
+   const unsigned char *labels     = nodes + nodeCount * DICT_TRIE_NODE_SIZE;
+   const unsigned char *node       = nodes;
+   unsigned long       nodeLo      = 0;
+   unsigned long       nodeHi      = headwords;
+   unsigned long       info, first, children, l, h, m, offset, len;
+   int                 pos = 0;
+   int                 c;
+
+   while (pos < keyLength) {
+      info     = dict_bin_u32( node + 12 );
+      children = DICT_TRIE_CHILDREN( info );
+      first    = dict_bin_u32( node + 4 );
+      if (!children || first + children > nodeCount)
+	 return 0;
+
+      c = (unsigned char) key[pos];
+      for (l = 0, h = children; l < h;) {
+	 m = l + (h - l) / 2;
+	 if ((int) DICT_TRIE_BYTE( dict_bin_u32( nodes + (first + m)
+						 * DICT_TRIE_NODE_SIZE + 12 ) )
+	     < c)
+	    l = m + 1;
+	 else
+	    h = m;
+      }
+      node = nodes + (first + l) * DICT_TRIE_NODE_SIZE;
+      info = dict_bin_u32( node + 12 );
+      if (l == children || (int) DICT_TRIE_BYTE( info ) != c)
+	 return 0;
+
+      if (l + 1 < children)
+	 nodeHi = dict_bin_u32( node + DICT_TRIE_NODE_SIZE );
+      nodeLo = dict_bin_u32( node );
+
+      offset = dict_bin_u32( node + 8 );
+      len    = DICT_TRIE_LABEL( info );
+      if (len > (unsigned long) (keyLength - pos))
+	 len = keyLength - pos;
+      if (offset > labelLength || len > labelLength - offset
+	  || memcmp( labels + offset, key + pos, len ))
+	 return 0;
+      pos += (int) len;
+   }
+
+   *lo = nodeLo;
+   *hi = nodeHi < headwords ? nodeHi : headwords;
+   return *lo < *hi;
+}
+
+/* Fill in |node| from its packed form at |pt|, given its run. */
+static int dict_trie_node(
+   const unsigned char *trie, const unsigned char *pt,
+   unsigned long lo, unsigned long hi,
+   dictTrieNode *node )
+{
+   unsigned long       nodeCount   = dict_bin_u32( trie );
+   unsigned long       labelLength = dict_bin_u32( trie + 4 );
+   const unsigned char *nodes      = trie + DICT_TRIE_HEADER_SIZE;
+   unsigned long       info        = dict_bin_u32( pt + 12 );
+   unsigned long       offset      = dict_bin_u32( pt + 8 );
+
+   node->lo          = lo;
+   node->hi          = hi;
+   node->first       = dict_bin_u32( pt + 4 );
+   node->children    = DICT_TRIE_CHILDREN( info );
+   node->labelLength = DICT_TRIE_LABEL( info );
+   node->label       = nodes + nodeCount * DICT_TRIE_NODE_SIZE + offset;
+   if (offset > labelLength || node->labelLength > labelLength - offset
+       || (node->children && node->first + node->children > nodeCount))
+      return 0;
+
+   node->end = node->children
+      ? dict_bin_u32( nodes + node->first * DICT_TRIE_NODE_SIZE ) : hi;
+   if (node->end > hi || node->end < lo)
+      return 0;
+   return 1;
+}
+
+void dict_trie_root(
+   const unsigned char *trie, unsigned long headwords,
+   dictTrieNode *node )
+{
+   if (!dict_trie_node( trie, trie + DICT_TRIE_HEADER_SIZE,
+			0, headwords, node ))
+      node->children = 0;
+}
+
+int dict_trie_child(
+   const unsigned char *trie,
+   const dictTrieNode *parent, unsigned long i,
+   dictTrieNode *child )
+{
+   const unsigned char *nodes = trie + DICT_TRIE_HEADER_SIZE;
+   const unsigned char *pt    = nodes + (parent->first + i)
+				* DICT_TRIE_NODE_SIZE;
+   unsigned long       lo     = dict_bin_u32( pt );
+   unsigned long       hi     = i + 1 < parent->children
+      ? dict_bin_u32( pt + DICT_TRIE_NODE_SIZE ) : parent->hi;
+
+   if (lo > hi || hi > parent->hi)
+      return 0;
+   return dict_trie_node( trie, pt, lo, hi, child );
+}
@@ -0,0 +1,78 @@
+/* trie.h -- Radix trie over normalized headwords
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 1, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef _TRIE_H_
+#define _TRIE_H_
+
+#include "binindex.h"
+
+/* The TRIE section is a path-compressed trie over the normalized
+   headwords.  Records are sorted by key, so the headwords below any
+   node are a contiguous run of records and a node only has to store
+   where its run starts:
+
+      nodes, label bytes
+      { first record, first child, label offset, info }[nodes]
+      labels
+
+   info packs the number of children (bits 0-8), the first byte of the
+   edge label (bits 9-16) and its length (bits 17-31).  Children are
+   stored together, sorted by that first byte, nodes in breadth-first
+   order; the root is node 0 and has an empty label.  A node's run ends
+   where its next sibling's starts, or where its parent's ends. */
+
+#define DICT_TRIE_HEADER_SIZE 8
+#define DICT_TRIE_NODE_SIZE   16
+
+/* Build the section for the |count| |entries|, which must be sorted by
+   key. */
+extern unsigned char *dict_trie_build (
+   const dictIndexEntry *entries, unsigned long count,
+   unsigned long *length );
+
+extern int dict_trie_valid (
+   const unsigned char *trie, unsigned long length );
+
+/* Store in [|lo|, |hi|) the records whose keys start with |key|.
+   Returns 0 if there are none. */
+extern int dict_trie_range (
+   const unsigned char *trie, unsigned long headwords,
+   const char *key, int keyLength,
+   unsigned long *lo, unsigned long *hi );
+
+/* A node as seen by a walk over the trie.  The records below it are
+   [|lo|, |hi|), and those whose headword ends at it are [|lo|, |end|). */
+typedef struct dictTrieNode {
+   unsigned long       lo, hi, end;
+   unsigned long       first;		/* number of the first child */
+   unsigned long       children;
+   const unsigned char *label;		/* edge leading here */
+   unsigned long       labelLength;
+} dictTrieNode;
+
+extern void dict_trie_root (
+   const unsigned char *trie, unsigned long headwords,
+   dictTrieNode *node );
+
+/* Fill |child| with child |i| of |parent|.  Returns 0 if the section is
+   malformed there. */
+extern int dict_trie_child (
+   const unsigned char *trie,
+   const dictTrieNode *parent, unsigned long i,
+   dictTrieNode *child );
+
+#endif /* _TRIE_H_ */